@@ -0,0 +1,532 @@
+// RayTracerBench: fixed-seed, fixed-camera renders of the book's scenes.
+//
+// For every scene and acceleration structure (BVHNode, the binary BVH, and
+// BVH4, the 4-wide one) it reports BVH build time, primary + secondary ray
+// throughput (Mrays/s), the cost of a bare world.hit() call and the cost of a
+// full path bounce (render time per path vertex: the hit, its shading and any
+// shadow rays), and writes the results as JSON so runs can be compared across
+// commits. Renders are reproducible: the scene is built
+// from a fixed seed and every pixel draws from its own RNG stream. The
+// "kernels" suite (kernels.cpp) times individual intersection routines, and
+// the "build" suite times serial against parallel BVH construction.
+
+#include "../include/rtweekend.h"
+#include "../include/hittable.h"
+#include "../include/bvh.h"
+#include "../include/bvh4.h"
+#include "../include/scheduler.h"
+#include "../include/headless.h"
+#include "../include/integrator.h"
+#include "../include/scenes.h"
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint64_t scene_seed = 0x5eed;
+const char* book_name = "TheNextWeek";
+const char* bvh_names[] = { "bvhnode", "bvh4" };
+const char* default_scenes[] = { "random", "cornell", "final" };
+
+// Written after the hit() timing loop so the calls cannot be optimised away.
+volatile size_t hit_sink = 0;
+
+struct BenchOptions {
+    std::vector<std::string> scenes;
+    std::vector<std::string> bvhs;
+    int width = 200;
+    int height = 200;
+    int samples_per_pixel = 8;
+    int max_depth = 8;
+    int repeat = 3;
+    bool run_scenes = true;
+    bool run_kernels = true;
+    bool run_build = true;
+    KernelOptions kernels;
+    int build_primitives = 1 << 18;
+    std::string json_path;
+};
+
+struct BenchResult {
+    std::string scene;
+    std::string bvh;
+    double scene_ms = 0;
+    BVHBuildStats bvh_stats;
+    double render_ms = 0;
+    uint64_t rays = 0;
+    uint64_t vertices = 0;
+    double mrays_per_s = 0;
+    double ns_per_hit = 0;
+    double ns_per_bounce = 0;
+    double ns_per_camera_hit = 0;
+    double ns_per_camera_hit_packet = 0;
+    double checksum = 0;
+};
+
+struct BuildResult {
+    BVHBuildStats serial;
+    BVHBuildStats parallel;
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A counter each thread bumps on its own cache line, so counting inside a
+// timed render does not make the threads contend. Threads get slots in the
+// order they first count; past max_slots they share, which stays correct.
+class ThreadCounter {
+public:
+    void add(uint64_t n = 1) {
+        slots[thread_slot() % max_slots].count.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (const Slot& slot : slots)
+            sum += slot.count.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    static const int max_slots = 64;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> count{0};
+    };
+
+    Slot slots[max_slots];
+
+    static int thread_slot() {
+        static std::atomic<int> next{0};
+        thread_local int slot = next++;
+        return slot;
+    }
+};
+
+// Forwards to the scene and counts every ray cast into it, and the path
+// vertices: the hits that found a surface to shade. With `record` set
+// (single-threaded use only) it also keeps the rays for the hit() timing.
+class CountingHittable : public Hittable {
+public:
+    CountingHittable(const Hittable& world, std::vector<RTRay>* record = nullptr)
+        : world(world), record(record) {}
+
+    bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
+        ray_count.add();
+        if (record) record->push_back(r);
+        if (!world.hit(r, ray_t, rec))
+            return false;
+        vertex_count.add();
+        return true;
+    }
+
+    int hit_packet(const RayPacket<packet_width>& rays, int active, interval ray_t,
+                   real t_max[packet_width], HitRecord rec[packet_width]) const override {
+        ray_count.add(lane_count(active));
+        if (record)
+            for (int i = 0; i < packet_width; i++)
+                if ((active >> i) & 1) record->push_back(rays.source ? rays.source[i] : rays.ray(i));
+        int hits = world.hit_packet(rays, active, ray_t, t_max, rec);
+        vertex_count.add(lane_count(hits));
+        return hits;
+    }
+
+    bool packet_hits() const override { return world.packet_hits(); }
+
+    AABB bounding_box() const override { return world.bounding_box(); }
+
+    uint64_t rays() const { return ray_count.total(); }
+    uint64_t vertices() const { return vertex_count.total(); }
+
+private:
+    const Hittable& world;
+    std::vector<RTRay>* record;
+    mutable ThreadCounter ray_count;
+    mutable ThreadCounter vertex_count;
+
+    static int lane_count(int mask) {
+        int count = 0;
+        for (int i = 0; i < packet_width; i++)
+            count += (mask >> i) & 1;
+        return count;
+    }
+};
+
+RTRay camera_ray(const Scene& scene, const BenchOptions& options, int i, int j) {
+    double u = (i + random_double()) / (options.width - 1);
+    double v = (j + random_double()) / (options.height - 1);
+    return scene.camera.get_ray(u, 1.0 - v);
+}
+
+std::vector<Color3> render(const Scene& scene, const Hittable& world, const BenchOptions& options) {
+    return render_headless(options.width, options.height, options.samples_per_pixel, [&](int i, int j) {
+        return ray_color(camera_ray(scene, options, i, j), world, options.max_depth);
+    });
+}
+
+// Times bare world.hit() over rays recorded from a single-threaded,
+// one sample per pixel pass, so the ray mix matches a real render. Each hit
+// is finished with finish_hit(), as the renderer does.
+double time_hit(const Scene& scene, const Hittable& world, const BenchOptions& options) {
+    std::vector<RTRay> rays;
+    CountingHittable recorder(world, &rays);
+    BenchOptions one_pass = options;
+    one_pass.samples_per_pixel = 1;
+
+    int threads = render_thread_setting();
+    set_render_threads(1);
+    render(scene, recorder, one_pass);
+    set_render_threads(threads);
+
+    if (rays.empty()) return 0;
+
+    HitRecord rec;
+    size_t hits = 0;
+    size_t calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    do {
+        for (const RTRay& r : rays) {
+            if (world.hit(r, interval(0.001, infinity), rec)) {
+                finish_hit(r, rec);
+                hits++;
+            }
+        }
+        calls += rays.size();
+    } while (elapsed_ms(start) < 200);
+    double ms = elapsed_ms(start);
+
+    hit_sink = hits;
+    return ms * 1e6 / calls;
+}
+
+// Times the first hit of every camera ray of a one sample per pixel pass,
+// traced one ray at a time with hit() and in 2x2 pixel packets with
+// hit_packet(), as the interactive viewer traces them, and finished with
+// finish_hit(). Both are reported per ray.
+void time_camera_hits(const Scene& scene, const Hittable& world, const BenchOptions& options, BenchResult& result) {
+    std::vector<RTRay> rays;
+    std::vector<RTRay> packet_rays;
+    std::vector<RayPacket<packet_width>> packets;
+    std::vector<int> active;
+    for_each_pixel_block(Tile{0, 0, options.width, options.height}, [&](const PixelBlock& block) {
+        RTRay lane_rays[packet_width];
+        for (int lane = 0; lane < packet_width; ++lane) {
+            if (!((block.active >> lane) & 1)) continue;
+            seed_thread_rng(0, uint64_t(block.j(lane)) * options.width + block.i(lane));
+            lane_rays[lane] = camera_ray(scene, options, block.i(lane), block.j(lane));
+            rays.push_back(lane_rays[lane]);
+        }
+        // Lane 0 of a block is always inside the frame; idle lanes repeat it.
+        RayPacket<packet_width> packet;
+        for (int lane = 0; lane < packet_width; ++lane) {
+            packet.set(lane, lane_rays[(block.active >> lane) & 1 ? lane : 0]);
+            packet_rays.push_back(lane_rays[lane]);
+        }
+        packets.push_back(packet);
+        active.push_back(block.active);
+    });
+    for (size_t k = 0; k < packets.size(); ++k)
+        packets[k].source = &packet_rays[k * packet_width];
+
+    const interval ray_t(0.001, infinity);
+    size_t hits = 0;
+    size_t calls = 0;
+    HitRecord rec;
+    auto start = std::chrono::steady_clock::now();
+    do {
+        for (const RTRay& r : rays) {
+            if (world.hit(r, ray_t, rec)) {
+                finish_hit(r, rec);
+                hits++;
+            }
+        }
+        calls += rays.size();
+    } while (elapsed_ms(start) < 200);
+    result.ns_per_camera_hit = elapsed_ms(start) * 1e6 / calls;
+
+    HitRecord recs[packet_width];
+    calls = 0;
+    start = std::chrono::steady_clock::now();
+    do {
+        for (size_t k = 0; k < packets.size(); ++k) {
+            real t_max[packet_width];
+            for (real& t : t_max) t = ray_t.max;
+            int mask = world.hit_packet(packets[k], active[k], ray_t, t_max, recs);
+            for (int lane = 0; lane < packet_width; ++lane) {
+                if ((mask >> lane) & 1) {
+                    finish_hit(packet_rays[k * packet_width + lane], recs[lane]);
+                    hits++;
+                }
+            }
+        }
+        calls += rays.size();
+    } while (elapsed_ms(start) < 200);
+    result.ns_per_camera_hit_packet = elapsed_ms(start) * 1e6 / calls;
+
+    hit_sink = hits;
+}
+
+// Builds a LinearBVH over a fixed set of random boxes, serially and in
+// parallel, and keeps the fastest of `repeat` builds of each. The book's
+// scenes are far below LinearBVH's parallel grain, so they would only ever
+// measure the serial path.
+BuildResult time_bvh_builds(const BenchOptions& options) {
+    seed_thread_rng(scene_seed);
+    std::vector<AABB> boxes(options.build_primitives);
+    for (AABB& box : boxes) {
+        Point3 center = Vec3::random(-100, 100);
+        Vec3 half = Vec3::random(0.05, 1);
+        box = AABB(center - half, center + half);
+    }
+
+    BuildResult result;
+    for (int run = 0; run < options.repeat; ++run) {
+        LinearBVH serial;
+        serial.build(boxes, BVHBuildMode::serial);
+        if (run == 0 || serial.stats.build_ms < result.serial.build_ms)
+            result.serial = serial.stats;
+
+        LinearBVH parallel;
+        parallel.build(boxes, BVHBuildMode::parallel);
+        if (run == 0 || parallel.stats.build_ms < result.parallel.build_ms)
+            result.parallel = parallel.stats;
+    }
+    return result;
+}
+
+// Collects the primitives under the scene's lists and BVHs, so that every
+// acceleration structure is built over the same flat set rather than on top
+// of the BVHs the scene already made. Transforms and media stay whole.
+void flatten(const std::shared_ptr<Hittable>& object, std::vector<std::shared_ptr<Hittable>>& out) {
+    if (auto list = std::dynamic_pointer_cast<HittableList>(object)) {
+        for (const auto& child : list->objects)
+            flatten(child, out);
+    } else if (auto bvh = std::dynamic_pointer_cast<BVHNode>(object)) {
+        for (const auto& child : bvh->objects())
+            flatten(child, out);
+    } else {
+        out.push_back(object);
+    }
+}
+
+bool run_scene(const std::string& name, const std::string& bvh, const BenchOptions& options, BenchResult& result) {
+    result.scene = name;
+    result.bvh = bvh;
+
+    seed_thread_rng(scene_seed);
+    auto start = std::chrono::steady_clock::now();
+    Scene scene;
+    if (!make_scene(name, double(options.width) / options.height, scene))
+        return false;
+    result.scene_ms = elapsed_ms(start);
+
+    std::vector<std::shared_ptr<Hittable>> objects;
+    for (const auto& object : scene.world.objects)
+        flatten(object, objects);
+    HittableList primitives;
+    for (const auto& object : objects)
+        primitives.add(object);
+
+    std::unique_ptr<Hittable> accelerator;
+    if (bvh == "bvh4") {
+        auto tree = std::make_unique<BVH4>(primitives);
+        result.bvh_stats = tree->build_stats();
+        accelerator = std::move(tree);
+    } else {
+        auto tree = std::make_unique<BVHNode>(primitives);
+        result.bvh_stats = tree->build_stats();
+        accelerator = std::move(tree);
+    }
+    const Hittable& world = *accelerator;
+
+    result.render_ms = -1;
+    for (int run = 0; run < options.repeat; ++run) {
+        CountingHittable counted(world);
+        start = std::chrono::steady_clock::now();
+        std::vector<Color3> buffer = render(scene, counted, options);
+        double ms = elapsed_ms(start);
+
+        if (result.render_ms < 0 || ms < result.render_ms) {
+            result.render_ms = ms;
+            result.rays = counted.rays();
+            result.vertices = counted.vertices();
+            result.checksum = 0;
+            for (const Color3& c : buffer)
+                result.checksum += (c.x + c.y + c.z) / options.samples_per_pixel;
+        }
+    }
+
+    result.mrays_per_s = result.rays / (result.render_ms * 1e3);
+    result.ns_per_bounce = result.render_ms * 1e6 * render_threads() / std::max<uint64_t>(result.vertices, 1);
+    result.ns_per_hit = time_hit(scene, world, options);
+    time_camera_hits(scene, world, options, result);
+    return true;
+}
+
+void write_build_json(std::ostream& out, const char* name, const BVHBuildStats& stats) {
+    out << "    \"" << name << "\": { \"build_ms\": " << stats.build_ms << ", \"threads\": " << stats.threads
+        << ", \"nodes\": " << stats.node_count << " }";
+}
+
+void write_json(std::ostream& out, const BenchOptions& options, const std::vector<BenchResult>& results,
+                const std::vector<KernelResult>& kernels, const BuildResult* build) {
+    out << "{\n"
+        << "  \"book\": \"" << book_name << "\",\n"
+        << "  \"threads\": " << render_threads() << ",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"spp\": " << options.samples_per_pixel << ",\n"
+        << "  \"max_depth\": " << options.max_depth << ",\n"
+        << "  \"repeat\": " << options.repeat << ",\n"
+        << "  \"results\": [\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const BenchResult& r = results[k];
+        out << "    {\n"
+            << "      \"scene\": \"" << r.scene << "\",\n"
+            << "      \"bvh\": \"" << r.bvh << "\",\n"
+            << "      \"scene_build_ms\": " << r.scene_ms << ",\n"
+            << "      \"bvh_build_ms\": " << r.bvh_stats.build_ms << ",\n"
+            << "      \"bvh_primitives\": " << r.bvh_stats.primitive_count << ",\n"
+            << "      \"bvh_nodes\": " << r.bvh_stats.node_count << ",\n"
+            << "      \"render_ms\": " << r.render_ms << ",\n"
+            << "      \"rays\": " << r.rays << ",\n"
+            << "      \"vertices\": " << r.vertices << ",\n"
+            << "      \"mrays_per_s\": " << r.mrays_per_s << ",\n"
+            << "      \"ns_per_hit\": " << r.ns_per_hit << ",\n"
+            << "      \"ns_per_bounce\": " << r.ns_per_bounce << ",\n"
+            << "      \"ns_per_camera_hit\": " << r.ns_per_camera_hit << ",\n"
+            << "      \"ns_per_camera_hit_packet\": " << r.ns_per_camera_hit_packet << ",\n"
+            << "      \"checksum\": " << r.checksum << "\n"
+            << "    }" << (k + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n"
+        << "  \"kernels\": ";
+    write_kernel_json(out, kernels);
+    out << ",\n"
+        << "  \"bvh_build\": ";
+    if (build) {
+        out << "{\n"
+            << "    \"primitives\": " << build->serial.primitive_count << ",\n";
+        write_build_json(out, "serial", build->serial);
+        out << ",\n";
+        write_build_json(out, "parallel", build->parallel);
+        out << "\n  }";
+    } else {
+        out << "null";
+    }
+    out << "\n}\n";
+}
+
+void print_usage(const char* program) {
+    std::cerr << "usage: " << program << " [--scene NAME]... [--bvh bvhnode|bvh4]... [--threads N] [--width N] [--height N]\n"
+              << "       [--spp N] [--depth N] [--repeat N] [--json FILE]\n"
+              << "       [--suite all|scenes|kernels|build] [--kernel-rays N] [--hit-rate X]\n"
+              << "       [--build-primitives N]\n";
+}
+
+bool parse_options(int argc, char** argv, BenchOptions& options) {
+    for (int a = 1; a < argc; ++a) {
+        const char* arg = argv[a];
+        if (a + 1 >= argc) {
+            print_usage(argv[0]);
+            return false;
+        }
+        const char* value = argv[++a];
+
+        if (std::strcmp(arg, "--scene") == 0) options.scenes.push_back(value);
+        else if (std::strcmp(arg, "--bvh") == 0 && (std::strcmp(value, "bvhnode") == 0 || std::strcmp(value, "bvh4") == 0))
+            options.bvhs.push_back(value);
+        else if (std::strcmp(arg, "--threads") == 0) set_render_threads(std::atoi(value));
+        else if (std::strcmp(arg, "--width") == 0) options.width = std::max(2, std::atoi(value));
+        else if (std::strcmp(arg, "--height") == 0) options.height = std::max(2, std::atoi(value));
+        else if (std::strcmp(arg, "--spp") == 0) options.samples_per_pixel = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--depth") == 0) options.max_depth = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--repeat") == 0) options.repeat = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--json") == 0) options.json_path = value;
+        else if (std::strcmp(arg, "--kernel-rays") == 0) options.kernels.rays = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--hit-rate") == 0) options.kernels.hit_rate = std::atof(value);
+        else if (std::strcmp(arg, "--build-primitives") == 0) options.build_primitives = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--suite") == 0 && std::strcmp(value, "all") == 0) {
+            options.run_scenes = options.run_kernels = options.run_build = true;
+        } else if (std::strcmp(arg, "--suite") == 0 && std::strcmp(value, "scenes") == 0) {
+            options.run_scenes = true;
+            options.run_kernels = options.run_build = false;
+        } else if (std::strcmp(arg, "--suite") == 0 && std::strcmp(value, "kernels") == 0) {
+            options.run_scenes = options.run_build = false;
+            options.run_kernels = true;
+        } else if (std::strcmp(arg, "--suite") == 0 && std::strcmp(value, "build") == 0) {
+            options.run_scenes = options.run_kernels = false;
+            options.run_build = true;
+        }
+        else {
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (options.scenes.empty())
+        options.scenes.assign(std::begin(default_scenes), std::end(default_scenes));
+    if (options.bvhs.empty())
+        options.bvhs.assign(std::begin(bvh_names), std::end(bvh_names));
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parse_options(argc, argv, options))
+        return 1;
+
+    std::vector<BenchResult> results;
+    for (const std::string& name : options.run_scenes ? options.scenes : std::vector<std::string>()) {
+        for (const std::string& bvh : options.bvhs) {
+            BenchResult result;
+            if (!run_scene(name, bvh, options, result))
+                return 1;
+            std::clog << name << " (" << bvh << "): " << result.mrays_per_s << " Mrays/s, "
+                      << result.ns_per_hit << " ns/hit, " << result.ns_per_bounce << " ns/bounce, camera hit "
+                      << result.ns_per_camera_hit << " ns (" << result.ns_per_camera_hit_packet << " ns in packets), BVH "
+                      << result.bvh_stats.build_ms << " ms\n";
+            results.push_back(result);
+        }
+    }
+
+    std::vector<KernelResult> kernels;
+    if (options.run_kernels) {
+        kernels = run_kernel_benchmarks(options.kernels);
+        for (const KernelResult& k : kernels)
+            std::clog << k.kernel << ": " << k.ns_per_call << " ns/call, hit rate " << k.hit_rate << '\n';
+    }
+
+    BuildResult build;
+    if (options.run_build) {
+        build = time_bvh_builds(options);
+        std::clog << "BVH build: serial " << build.serial << "; parallel " << build.parallel << '\n';
+    }
+    const BuildResult* build_result = options.run_build ? &build : nullptr;
+
+    if (options.json_path.empty()) {
+        write_json(std::cout, options, results, kernels, build_result);
+    } else {
+        std::ofstream out(options.json_path);
+        if (!out) {
+            std::cerr << "ERROR: Could not open '" << options.json_path << "' for writing.\n";
+            return 1;
+        }
+        write_json(out, options, results, kernels, build_result);
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef RT_BENCH_KERNELS_H
+#define RT_BENCH_KERNELS_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Isolated intersection-kernel benchmarks. Each kernel is timed on a
+// pre-generated batch of rays whose hit fraction is set by `hit_rate`, so a
+// change to one kernel's maths or layout can be measured on its own.
+struct KernelOptions {
+    int rays = 1 << 16;
+    double hit_rate = 0.5;
+    double min_ms = 100;
+};
+
+struct KernelResult {
+    std::string kernel;
+    int batch = 0;
+    double target_hit_rate = 0;
+    double hit_rate = 0;
+    double ns_per_call = 0;
+    double mcalls_per_s = 0;
+};
+
+std::vector<KernelResult> run_kernel_benchmarks(const KernelOptions& options);
+
+void write_kernel_json(std::ostream& out, const std::vector<KernelResult>& results);
+
+#endif
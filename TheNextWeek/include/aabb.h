@@ -31,21 +31,28 @@ public:
         return x;
     }
 
+    int longest_axis() const {
+        if (x.size() > y.size())
+            return x.size() > z.size() ? 0 : 2;
+        else
+            return y.size() > z.size() ? 1 : 2;
+    }
+
+    real surface_area() const {
+        auto dx = x.size(), dy = y.size(), dz = z.size();
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+
     bool hit(const RTRay& r, interval ray_t) const {
         for (int a = 0; a < 3; a++) {
             const auto& ax = axis(a);
-            const double adinv = 1.0 / r.direction[a];
-
-            auto t0 = (ax.min - r.origin[a]) * adinv;
-            auto t1 = (ax.max - r.origin[a]) * adinv;
-
-            if (t0 < t1) {
-                if (t0 > ray_t.min) ray_t.min = t0;
-                if (t1 < ray_t.max) ray_t.max = t1;
-            } else {
-                if (t1 > ray_t.min) ray_t.min = t1;
-                if (t0 < ray_t.max) ray_t.max = t0;
-            }
+
+            // The ray enters through the max plane when it points down the axis.
+            auto t0 = ((r.sign[a] ? ax.max : ax.min) - r.origin[a]) * r.inv_direction[a];
+            auto t1 = ((r.sign[a] ? ax.min : ax.max) - r.origin[a]) * r.inv_direction[a];
+
+            if (t0 > ray_t.min) ray_t.min = t0;
+            if (t1 < ray_t.max) ray_t.max = t1;
 
             if (ray_t.max <= ray_t.min)
                 return false;
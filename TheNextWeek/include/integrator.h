@@ -0,0 +1,139 @@
+#ifndef RT_INTEGRATOR_H
+#define RT_INTEGRATOR_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "material.h"
+#include "scheduler.h"
+#include "simd.h"
+
+#include <cmath>
+
+// Paths stop being forced to continue after this many bounces; from then on
+// each bounce survives with probability equal to the brightest throughput
+// channel and the survivors are reweighted, so the estimate stays unbiased.
+const int roulette_min_bounces = 3;
+
+inline bool russian_roulette(Color3& throughput) {
+    double survive = std::fmin(std::fmax(throughput.x, std::fmax(throughput.y, throughput.z)), 0.95);
+    if (random_double() >= survive)
+        return false;
+    throughput = throughput / survive;
+    return true;
+}
+
+// Continues the path of camera ray `r` whose first intersection is already
+// known (from trace_camera_packet): `first_hit` says whether `r` hit
+// anything and `first` is the record if it did.
+inline Color3 ray_color(const RTRay& r, bool first_hit, const HitRecord& first, const Hittable& world, int depth) {
+    Color3 radiance(0, 0, 0);
+    Color3 throughput(1, 1, 1);
+    RTRay ray = r;
+    HitRecord rec = first;
+
+    for (int bounce = 0; bounce < depth; bounce++) {
+        bool hit = bounce == 0 ? first_hit : world.hit(ray, interval(0.001, infinity), rec);
+        if (!hit)
+            break;
+        finish_hit(ray, rec);
+
+        radiance += throughput * rec.mat->emitted(rec.u, rec.v, rec.p);
+
+        RTRay scattered;
+        Color3 attenuation;
+        if (!rec.mat->scatter(ray, rec, attenuation, scattered))
+            break;
+
+        throughput = throughput * attenuation;
+        ray = scattered;
+
+        if (bounce + 1 >= roulette_min_bounces && !russian_roulette(throughput))
+            break;
+    }
+
+    return radiance;
+}
+
+inline Color3 ray_color(const RTRay& r, const Hittable& world, int depth) {
+    HitRecord rec{};
+    bool hit = depth > 0 && world.hit(r, interval(0.001, infinity), rec);
+    return ray_color(r, hit, rec, world, depth);
+}
+
+// A 2x2 block of pixels traced as one packet: lane k is pixel
+// (x + (k & 1), y + (k >> 1)), and lanes that fall outside the tile are left
+// out of `active`.
+struct PixelBlock {
+    int x, y;
+    int active;
+
+    int i(int lane) const { return x + (lane & 1); }
+    int j(int lane) const { return y + (lane >> 1); }
+};
+
+template <typename Body>
+inline void for_each_pixel_block(const Tile& tile, const Body& body) {
+    for (int y = tile.y0; y < tile.y1; y += 2) {
+        for (int x = tile.x0; x < tile.x1; x += 2) {
+            PixelBlock block{x, y, 0};
+            for (int lane = 0; lane < packet_width; lane++)
+                if (block.i(lane) < tile.x1 && block.j(lane) < tile.y1)
+                    block.active |= 1 << lane;
+            body(block);
+        }
+    }
+}
+
+// Traces the camera rays of a pixel block as one packet to their first hit
+// (if every shape in `world` has a packet test), then finishes each path on
+// its own: after the first bounce the rays scatter in all directions and a
+// packet would mostly hold idle lanes.
+// make_ray(lane) samples lane's camera ray. rng[lane] is the lane's sampler;
+// it is swapped in around make_ray and the rest of that lane's path, so
+// every pixel gets exactly the result it would get traced alone.
+template <typename MakeRay>
+inline void trace_camera_packet(int active, Pcg32 rng[packet_width], const MakeRay& make_ray,
+                                const Hittable& world, int depth, Color3 color[packet_width]) {
+    RTRay rays[packet_width];
+    RayPacket<packet_width> packet;
+    int lead = -1;
+    for (int lane = 0; lane < packet_width; lane++) {
+        if (!((active >> lane) & 1)) continue;
+        thread_rng() = rng[lane];
+        rays[lane] = make_ray(lane);
+        rng[lane] = thread_rng();
+        if (lead < 0) lead = lane;
+    }
+    if (lead < 0) return;
+
+    // A world with shapes that lack a packet test would test them one lane
+    // at a time anyway, at a higher cost than tracing each ray on its own.
+    if (!world.packet_hits()) {
+        for (int lane = 0; lane < packet_width; lane++) {
+            if (!((active >> lane) & 1)) continue;
+            thread_rng() = rng[lane];
+            color[lane] = ray_color(rays[lane], world, depth);
+            rng[lane] = thread_rng();
+        }
+        return;
+    }
+
+    // Idle lanes repeat a live ray so every lane holds finite numbers.
+    for (int lane = 0; lane < packet_width; lane++)
+        packet.set(lane, rays[(active >> lane) & 1 ? lane : lead]);
+    packet.source = rays;
+
+    real t_max[packet_width];
+    HitRecord rec[packet_width]{};
+    for (real& t : t_max) t = infinity;
+    int hits = depth > 0 ? world.hit_packet(packet, active, interval(0.001, infinity), t_max, rec) : 0;
+
+    for (int lane = 0; lane < packet_width; lane++) {
+        if (!((active >> lane) & 1)) continue;
+        thread_rng() = rng[lane];
+        color[lane] = ray_color(rays[lane], (hits >> lane) & 1, rec[lane], world, depth);
+        rng[lane] = thread_rng();
+    }
+}
+
+#endif
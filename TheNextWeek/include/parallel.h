@@ -0,0 +1,73 @@
+#ifndef RT_PARALLEL_H
+#define RT_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+inline int& render_thread_setting() {
+    static int threads = 0;
+    return threads;
+}
+
+// 0 (the default) means "one worker per hardware thread".
+inline void set_render_threads(int threads) {
+    render_thread_setting() = threads > 0 ? threads : 0;
+}
+
+inline int render_threads() {
+    if (render_thread_setting() > 0)
+        return render_thread_setting();
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    unsigned int hw = std::thread::hardware_concurrency();
+    return hw > 0 ? int(hw) : 1;
+#endif
+}
+
+template <typename Body>
+void parallel_for(int begin, int end, const Body& body) {
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(render_threads())
+    for (int i = begin; i < end; ++i)
+        body(i);
+#else
+    std::atomic<int> next(begin);
+    auto worker = [&]() {
+        for (int i = next++; i < end; i = next++)
+            body(i);
+    };
+
+    int workers = std::min(render_threads(), end - begin);
+    std::vector<std::thread> pool;
+    for (int t = 1; t < workers; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+#endif
+}
+
+// Runs body(worker) once on each of `workers` threads and waits for all of them.
+template <typename Body>
+void run_workers(int workers, const Body& body) {
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(workers)
+    body(omp_get_thread_num());
+#else
+    std::vector<std::thread> pool;
+    for (int t = 1; t < workers; ++t)
+        pool.emplace_back([&body, t]() { body(t); });
+    body(0);
+    for (auto& thread : pool)
+        thread.join();
+#endif
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "rtweekend.h"
 #include "hittable.h"
 #include <cmath>
+#include <limits>
 
 class Quad : public Hittable {
 public:
@@ -45,12 +46,64 @@ public:
         if (!is_interior(alpha, beta, rec))
             return false;
 
+        // is_interior() has already stored u and v.
         rec.t = t;
-        rec.p = intersection;
-        rec.mat = mat;
+        rec.object = this;
+        return true;
+    }
+
+    void set_surface(const RTRay& r, HitRecord& rec) const override {
+        rec.p = r.at(rec.t);
+        rec.mat = mat.get();
         rec.set_face_normal(r, normal);
+    }
 
-        return true;
+    int hit_packet(const RayPacket<packet_width>& rays, int active, interval ray_t,
+                   real t_max[packet_width], HitRecord rec[packet_width]) const override {
+        return hit_packet<packet_width>(rays, active, ray_t, t_max, rec);
+    }
+
+    bool packet_hits() const override { return true; }
+
+    // Packet version of hit(): active lane i hits if the quad is crossed in
+    // [ray_t.min, t_max[i]]; then rec[i] records the hit, t_max[i] lowered to the
+    // hit and bit i of the returned mask set. The plane and barycentric tests
+    // run across all lanes; is_interior() only runs for active lanes that
+    // reach the plane in range.
+    template <int N>
+    int hit_packet(const RayPacket<N>& rays, int active, const interval& ray_t, real t_max[N], HitRecord rec[N]) const {
+        real denom[N], t[N];
+        dot(rays.direction, normal, denom);
+        dot(rays.origin, normal, t);
+
+        // Lanes that miss the plane or its range get t = NaN, which fails
+        // every comparison, keeping every array `real`-wide so the loop
+        // vectorizes.
+        real alpha[N], beta[N];
+        RT_LANE_LOOP
+        for (int i = 0; i < N; i++) {
+            real t_plane = (D - t[i]) / denom[i];
+            real px = rays.origin.x[i] + t_plane * rays.direction.x[i] - Q.x;
+            real py = rays.origin.y[i] + t_plane * rays.direction.y[i] - Q.y;
+            real pz = rays.origin.z[i] + t_plane * rays.direction.z[i] - Q.z;
+
+            // dot(w, cross(p, v)) and dot(w, cross(u, p)) written out.
+            alpha[i] = w.x * (py * v.z - pz * v.y) + w.y * (pz * v.x - px * v.z) + w.z * (px * v.y - py * v.x);
+            beta[i] = w.x * (u.y * pz - u.z * py) + w.y * (u.z * px - u.x * pz) + w.z * (u.x * py - u.y * px);
+            bool in_range = (std::fabs(denom[i]) >= 1e-8) & (ray_t.min <= t_plane) & (t_plane <= t_max[i]);
+            t[i] = in_range ? t_plane : std::numeric_limits<real>::quiet_NaN();
+        }
+
+        int mask = 0;
+        for (int i = 0; i < N; i++) {
+            if (!((active >> i) & 1) || !(t[i] <= t_max[i]) || !is_interior(alpha[i], beta[i], rec[i]))
+                continue;
+            rec[i].t = t[i];
+            rec[i].object = this;
+            t_max[i] = t[i];
+            mask |= 1 << i;
+        }
+        return mask;
     }
 
     virtual bool is_interior(double a, double b, HitRecord& rec) const {
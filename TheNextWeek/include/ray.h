@@ -7,13 +7,24 @@ class RTRay {
 public:
     Point3 origin;
     Vec3 direction;
-    double tm;
+    real tm;
+
+    // 1 / direction and the sign of each direction component (1 for
+    // negative), computed once here for every box the ray is tested against.
+    // Build a new ray rather than assigning to `direction`.
+    Vec3 inv_direction;
+    int sign[3];
 
     RTRay() {}
-    RTRay(const Point3& origin, const Vec3& direction, double tm = 0.0)
-        : origin(origin), direction(direction), tm(tm) {}
+    RTRay(const Point3& origin, const Vec3& direction, real tm = 0.0)
+        : origin(origin), direction(direction), tm(tm),
+          inv_direction(1.0 / direction.x, 1.0 / direction.y, 1.0 / direction.z) {
+        sign[0] = inv_direction.x < 0;
+        sign[1] = inv_direction.y < 0;
+        sign[2] = inv_direction.z < 0;
+    }
 
-    Point3 at(double t) const {
+    Point3 at(real t) const {
         return origin + t * direction;
     }
 };
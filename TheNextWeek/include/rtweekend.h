@@ -25,19 +25,7 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
-inline double random_double() {
-    return std::rand() / (RAND_MAX + 1.0);
-}
-
-inline double random_double(double min, double max) {
-    return min + (max-min)*random_double();
-}
-
-inline int random_int(int min, int max) {
-    return int(random_double(min, max+1));
-}
-
-
+#include "random.h"
 #include "interval.h"
 #include "ray.h"
 #include "vec3.h"
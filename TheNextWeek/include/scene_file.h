@@ -0,0 +1,37 @@
+#ifndef RT_SCENE_FILE_H
+#define RT_SCENE_FILE_H
+
+#include "scenes.h"
+
+#include <string>
+
+// Text scene descriptions (".scene" files). A file is a list of blocks:
+//
+//     # comment
+//     camera { from: 278 278 -800  at: 278 278 0  vfov: 40 }
+//     texture checks checker { scale: 0.32  even: .2 .3 .1  odd: .9 .9 .9 }
+//     material white lambertian { albedo: .73 .73 .73 }
+//     material floor lambertian { albedo: checks }
+//     box { min: 0 0 0  max: 165 330 165  material: white  rotate_y: 15  translate: 265 0 295 }
+//
+// Textures: solid (color), checker (scale, even, odd), noise (scale) and
+// image (file). Materials: lambertian (albedo), metal (albedo, fuzz),
+// dielectric (ior), light (emit) and isotropic (albedo); a color value may
+// also name a texture. Shapes: sphere (center, [center2,] radius), quad
+// (q, u, v) and box (min, max), each with a material and any number of
+// rotate_y / translate keys, applied in the order written. "medium: density"
+// turns a shape into the boundary of a ConstantMedium with color
+// "medium_albedo". "light:" marks a shape as a light (only used by Book 3's
+// light sampling). Camera keys: from, at, up, vfov, aperture, focus_dist.
+//
+// Blocks are built as they are read, so names must be defined before use.
+// Relative file names are resolved against the scene file's directory.
+
+// True if `name` refers to a scene file rather than a built-in scene.
+bool is_scene_file(const std::string& name);
+
+// Reads `path` into `scene`. Prints "ERROR: file:line: ..." and returns
+// false on the first error.
+bool load_scene_file(const std::string& path, double aspect_ratio, Scene& scene);
+
+#endif
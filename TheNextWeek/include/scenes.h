@@ -0,0 +1,29 @@
+#ifndef RT_SCENES_H
+#define RT_SCENES_H
+
+#include "camera.h"
+#include "hittable.h"
+
+#include <memory>
+#include <string>
+
+class RTMaterial;
+
+struct Scene {
+    HittableList world;
+    RTCamera camera;
+};
+
+HittableList random_scene();
+HittableList quads_scene();
+HittableList simple_light();
+std::shared_ptr<HittableList> box(const Point3& a, const Point3& b, std::shared_ptr<RTMaterial> mat);
+HittableList cornell_box();
+HittableList final_scene();
+
+// Builds the named scene (empty selects "final", a name ending in ".scene"
+// is read with load_scene_file) with its camera. Prints the available names
+// and returns false when `name` is unknown.
+bool make_scene(const std::string& name, double aspect_ratio, Scene& scene);
+
+#endif
@@ -2,52 +2,50 @@
 #include <cmath>
 #include <iostream>
 
+#include "random.h"
+#include "real.h"
+
 class Vec3 {
 public:
-    double x, y, z;
+    real x, y, z;
 
-    double operator[](int i) const {
-        if (i == 0) return x;
-        if (i == 1) return y;
-        return z;
-    }
+    static constexpr real Vec3::* axes[3] = {&Vec3::x, &Vec3::y, &Vec3::z};
 
-    double& operator[](int i) {
-        if (i == 0) return x;
-        if (i == 1) return y;
-        return z;
-    }
+    // Indexes through a member-pointer table instead of comparing i, so a
+    // loop over axes compiles to a load rather than a chain of branches.
+    real operator[](int i) const { return this->*axes[i]; }
+    real& operator[](int i) { return this->*axes[i]; }
 
     Vec3() : x(0), y(0), z(0) {}
-    Vec3(double x, double y, double z) : x(x), y(y), z(z) {}
+    Vec3(real x, real y, real z) : x(x), y(y), z(z) {}
 
     Vec3 operator-() const { return Vec3(-x, -y, -z); }
     Vec3 operator+(const Vec3& v) const { return Vec3(x + v.x, y + v.y, z + v.z); }
     Vec3 operator-(const Vec3& v) const { return Vec3(x - v.x, y - v.y, z - v.z); }
     Vec3 operator*(const Vec3& v) const { return Vec3(x * v.x, y * v.y, z * v.z); }
-    Vec3 operator*(double t) const { return Vec3(x * t, y * t, z * t); }
-    Vec3 operator/(double t) const { return *this * (1.0 / t); }
+    Vec3 operator*(real t) const { return Vec3(x * t, y * t, z * t); }
+    Vec3 operator/(real t) const { return *this * (1.0 / t); }
 
     Vec3& operator+=(const Vec3& v) {
         x += v.x; y += v.y; z += v.z;
         return *this;
     }
 
-    Vec3& operator*=(double t) {
+    Vec3& operator*=(real t) {
         x *= t; y *= t; z *= t;
         return *this;
     }
 
-    double length() const {
+    real length() const {
         return std::sqrt(length_squared());
     }
 
-    double length_squared() const {
+    real length_squared() const {
         return x * x + y * y + z * z;
     }
 
     bool near_zero() const {
-        const double s = 1e-8;
+        const real s = 1e-8;
         return (std::fabs(x) < s) && (std::fabs(y) < s) && (std::fabs(z) < s);
     }
 
@@ -55,28 +53,19 @@ public:
         return Vec3(random_double(), random_double(), random_double());
     }
 
-    static Vec3 random(double min, double max) {
+    static Vec3 random(real min, real max) {
         return Vec3(random_double(min, max), random_double(min, max), random_double(min, max));
     }
-
-private:
-    static double random_double() {
-        return rand() / (RAND_MAX + 1.0);
-    }
-
-    static double random_double(double min, double max) {
-        return min + (max - min) * random_double();
-    }
 };
 
 using Point3 = Vec3;
 using Color3 = Vec3;  
 
-inline Vec3 operator*(double t, const Vec3& v) {
+inline Vec3 operator*(real t, const Vec3& v) {
     return v * t;
 }
 
-inline double dot(const Vec3& u, const Vec3& v) {
+inline real dot(const Vec3& u, const Vec3& v) {
     return u.x * v.x + u.y * v.y + u.z * v.z;
 }
 
@@ -114,8 +103,8 @@ inline Vec3 reflect(const Vec3& v, const Vec3& n) {
     return v - 2 * dot(v, n) * n;
 }
 
-inline Vec3 refract(const Vec3& uv, const Vec3& n, double etai_over_etat) {
-    double cos_theta = std::fmin(dot(-uv, n), 1.0);
+inline Vec3 refract(const Vec3& uv, const Vec3& n, real etai_over_etat) {
+    real cos_theta = std::fmin(dot(-uv, n), 1.0);
     Vec3 r_out_perp = etai_over_etat * (uv + cos_theta * n);
     Vec3 r_out_parallel = -std::sqrt(std::fabs(1.0 - r_out_perp.length_squared())) * n;
     return r_out_perp + r_out_parallel;
@@ -11,31 +11,20 @@
 #include "../include/quad.h"
 #include "../include/transform.h"
 #include "../include/constant_medium.h"
+#include "../include/scheduler.h"
+#include "../include/headless.h"
+#include "../include/adaptive.h"
+#include "../include/integrator.h"
+#include "../include/scenes.h"
 
+#include <algorithm>
 #include <memory>
 #include <vector>
+#include <iostream>
 #include <cmath>
 #include <cstdlib>
-#include <ctime>
-
-Color3 ray_color(const RTRay& r, const HittableList& world, int depth) {
-    if (depth <= 0)
-        return Color3(0, 0, 0);
-
-    HitRecord rec;
-
-        if (!world.hit(r, interval(0.001, infinity), rec))
-            return Color3(0, 0, 0);
-
-        Color3 emission_color = rec.mat->emitted(rec.u, rec.v, rec.p);
-        RTRay scattered;
-        Color3 attenuation;
-
-        if (rec.mat->scatter(r, rec, attenuation, scattered)) {
-            return emission_color + attenuation * ray_color(scattered, world, depth - 1);
-        }
-        return emission_color;
-}
+#include <cstring>
+#include <string>
 
 HittableList create_scene() {
     HittableList world;
@@ -55,267 +44,47 @@ HittableList create_scene() {
     return world;
 }
 
-void buffer_to_image(Image& image, const std::vector<Color3>& buffer, int width, int height, int accumulated_samples) {
-    double scale = 1.0 / accumulated_samples;
-    unsigned char* pixels = (unsigned char*)image.data;
-    
-    interval intensity(0.000, 0.999);
-
-    for (int j = 0; j < height; j++) {
-        for (int i = 0; i < width; i++) {
-            int pixel_index = (j * width + i) * 4; 
-            
-            Color3 col = buffer[j * width + i] * scale;
-            
-            col.x = sqrt(col.x);
-            col.y = sqrt(col.y);
-            col.z = sqrt(col.z);
-            
-            pixels[pixel_index + 0] = (unsigned char)(256 * intensity.clamp(col.x));
-            pixels[pixel_index + 1] = (unsigned char)(256 * intensity.clamp(col.y));
-            pixels[pixel_index + 2] = (unsigned char)(256 * intensity.clamp(col.z));
-            pixels[pixel_index + 3] = 255;
-        }
-    }
-}
-
-    HittableList random_scene() {
-        HittableList world;
-
-        auto checker = std::make_shared<CheckerTexture>(0.32, Color3(0.2, 0.3, 0.1), Color3(0.9, 0.9, 0.9));
-        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(checker)));
-        auto ground_material = std::make_shared<Lambertian>(checker);
-        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
-
-        auto earth_texture = std::make_shared<ImageTexture>("earthmap.png");
-        auto earth_surface = std::make_shared<Lambertian>(earth_texture);
-        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, earth_surface));
-        world.add(std::make_shared<Sphere>(Point3(0, 2, 0), 1.5, earth_surface));
-
-        auto pertext = std::make_shared<NoiseTexture>(4.0);
-        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(pertext)));
-        world.add(std::make_shared<Sphere>(Point3(0, 2, 0), 2, std::make_shared<Lambertian>(pertext)));
-
-        for (int a = -5; a < 5; a++) {
-            for (int b = -5; b < 5; b++) {
-                auto choose_mat = random_double();
-                Point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
-
-                if ((center - Point3(4, 0.2, 0)).length() > 0.9) {
-                    std::shared_ptr<RTMaterial> sphere_material;
-
-                    if (choose_mat < 0.8) {
-                        auto albedo = Color3::random() * Color3::random();
-                        sphere_material = std::make_shared<Lambertian>(albedo);
-                        
-                        auto center2 = center + Vec3(0, random_double(0, 0.5), 0);
-                        world.add(std::make_shared<Sphere>(center, center2, 0.2, sphere_material));
-                    } else if (choose_mat < 0.95) {
-                        auto albedo = Color3::random(0.5, 1);
-                        auto fuzz = random_double(0, 0.5);
-                        sphere_material = std::make_shared<Metal>(albedo, fuzz);
-                        world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
-                    } else {
-                        sphere_material = std::make_shared<Dielectric>(1.5);
-                        world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
-                    }
-                }
-            }
-        }
-
-        auto material1 = std::make_shared<Dielectric>(1.5);
-        world.add(std::make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
-
-        auto material2 = std::make_shared<Lambertian>(Color3(0.4, 0.2, 0.1));
-        world.add(std::make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
-
-        auto material3 = std::make_shared<Metal>(Color3(0.7, 0.6, 0.5), 0.0);
-        world.add(std::make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
-
-        return HittableList(std::make_shared<BVHNode>(world));
-    }
-
-    HittableList quads_scene() {
-        HittableList world;
-    
-        auto left_red     = std::make_shared<Lambertian>(Color3(1.0, 0.2, 0.2));
-        auto back_green   = std::make_shared<Lambertian>(Color3(0.2, 1.0, 0.2));
-        auto right_blue   = std::make_shared<Lambertian>(Color3(0.2, 0.2, 1.0));
-        auto upper_orange = std::make_shared<Lambertian>(Color3(1.0, 0.5, 0.0));
-        auto lower_teal   = std::make_shared<Lambertian>(Color3(0.2, 0.8, 0.8));
-    
-        world.add(std::make_shared<Quad>(Point3(-3,-2, 5), Vec3(0, 0,-4), Vec3(0, 4, 0), left_red));
-        world.add(std::make_shared<Quad>(Point3(-2,-2, 0), Vec3(4, 0, 0), Vec3(0, 4, 0), back_green));
-        world.add(std::make_shared<Quad>(Point3( 3,-2, 1), Vec3(0, 0, 4), Vec3(0, 4, 0), right_blue));
-        world.add(std::make_shared<Quad>(Point3(-2, 3, 1), Vec3(4, 0, 0), Vec3(0, 0, 4), upper_orange));
-        world.add(std::make_shared<Quad>(Point3(-2,-3, 5), Vec3(4, 0, 0), Vec3(0, 0,-4), lower_teal));
-    
-        return world;
-    }
-
-    HittableList simple_light() {
-        HittableList world;
-    
-        auto pertext = std::make_shared<NoiseTexture>(4);
-        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(pertext)));
-        world.add(std::make_shared<Sphere>(Point3(0, 2, 0), 2, std::make_shared<Lambertian>(pertext)));
-    
-        auto difflight = std::make_shared<DiffuseLight>(Color3(4, 4, 4));
-        world.add(std::make_shared<Quad>(Point3(3, 1, -2), Vec3(2, 0, 0), Vec3(0, 2, 0), difflight));
-        world.add(std::make_shared<Sphere>(Point3(0, 7, 0), 2, difflight));
-        return world;
-    }
-
-    std::shared_ptr<HittableList> box(const Point3& a, const Point3& b, std::shared_ptr<RTMaterial> mat) {
-        auto sides = std::make_shared<HittableList>();
-    
-        Point3 min(fmin(a.x, b.x), fmin(a.y, b.y), fmin(a.z, b.z));
-        Point3 max(fmax(a.x, b.x), fmax(a.y, b.y), fmax(a.z, b.z));
-    
-        Vec3 dx(max.x - min.x, 0, 0);
-        Vec3 dy(0, max.y - min.y, 0);
-        Vec3 dz(0, 0, max.z - min.z);
-    
-        sides->add(std::make_shared<Quad>(Point3(min.x, min.y, max.z),  dx,  dy, mat)); 
-        sides->add(std::make_shared<Quad>(Point3(max.x, min.y, max.z), -dz,  dy, mat)); 
-        sides->add(std::make_shared<Quad>(Point3(max.x, min.y, min.z), -dx,  dy, mat)); 
-        sides->add(std::make_shared<Quad>(Point3(min.x, min.y, min.z),  dz,  dy, mat)); 
-        sides->add(std::make_shared<Quad>(Point3(min.x, max.y, max.z),  dx, -dz, mat)); 
-        sides->add(std::make_shared<Quad>(Point3(min.x, min.y, min.z),  dx,  dz, mat));
-    
-        return sides;
-    }
-
-    HittableList cornell_box() {
-        HittableList world;
-    
-        auto red   = std::make_shared<Lambertian>(Color3(0.65, 0.05, 0.05));
-        auto white = std::make_shared<Lambertian>(Color3(0.73, 0.73, 0.73));
-        auto green = std::make_shared<Lambertian>(Color3(0.12, 0.45, 0.15));
-        auto light = std::make_shared<DiffuseLight>(Color3(15, 15, 15)); 
-    
-        
-        world.add(std::make_shared<Quad>(Point3(555, 0, 0), Vec3(0, 555, 0), Vec3(0, 0, 555), green));
-        world.add(std::make_shared<Quad>(Point3(0, 0, 0), Vec3(0, 555, 0), Vec3(0, 0, 555), red));
-        world.add(std::make_shared<Quad>(Point3(343, 554, 332), Vec3(-130, 0, 0), Vec3(0, 0, -105), light));
-        world.add(std::make_shared<Quad>(Point3(0, 0, 0), Vec3(555, 0, 0), Vec3(0, 0, 555), white));
-        world.add(std::make_shared<Quad>(Point3(555, 555, 555), Vec3(-555, 0, 0), Vec3(0, 0, -555), white));
-        world.add(std::make_shared<Quad>(Point3(0, 0, 555), Vec3(555, 0, 0), Vec3(0, 555, 0), white));
-
-
-        world.add(box(Point3(130, 0, 65), Point3(295, 165, 230), white));
-        world.add(box(Point3(265, 0, 295), Point3(430, 330, 460), white));
-
-        std::shared_ptr<Hittable> box1 = box(Point3(0, 0, 0), Point3(165, 330, 165), white);
-        box1 = std::make_shared<RotateY>(box1, 15);
-        box1 = std::make_shared<Translate>(box1, Vec3(265, 0, 295));
-
-        std::shared_ptr<Hittable> box2 = box(Point3(0, 0, 0), Point3(165, 165, 165), white);
-        box2 = std::make_shared<RotateY>(box2, -18);
-        box2 = std::make_shared<Translate>(box2, Vec3(130, 0, 65));
+int main(int argc, char** argv) {
+    RenderOptions options;
+    if (!parse_render_options(argc, argv, options))
+        return 1;
 
-        world.add(std::make_shared<ConstantMedium>(box1, 0.01, Color3(0, 0, 0))); 
-        world.add(std::make_shared<ConstantMedium>(box2, 0.01, Color3(1, 1, 1)));
+    const int screen_width = options.width > 0 ? options.width : 200;
+    const int screen_height = options.height > 0 ? options.height : 200;
+    const double aspect_ratio = double(screen_width) / screen_height;
 
-    return world;
-    }
+    int samples_per_pixel = 50; 
+    int max_depth = options.max_depth > 0 ? options.max_depth : 8;
+    bool is_rendering = true;
+    int accumulated_samples = 0;
 
-    HittableList final_scene() {
-        HittableList boxes1;
-        auto ground = std::make_shared<Lambertian>(Color3(0.48, 0.83, 0.53));
-        int boxes_per_side = 5;
-        for (int i = 0; i < boxes_per_side; i++) {
-            for (int j = 0; j < boxes_per_side; j++) {
-                auto w = 100.0;
-                auto x0 = -1000.0 + i * w;
-                auto z0 = -1000.0 + j * w;
-                auto y0 = 0.0;
-                auto x1 = x0 + w;
-                auto y1 = random_double(1, 101); 
-                auto z1 = z0 + w;
-    
-                boxes1.add(box(Point3(x0, y0, z0), Point3(x1, y1, z1), ground));
-            }
-        }
-        HittableList world;
-    
-        world.add(std::make_shared<BVHNode>(boxes1));
-    
-        auto light = std::make_shared<DiffuseLight>(Color3(7, 7, 7));
-        world.add(std::make_shared<Quad>(Point3(123, 554, 147), Vec3(300, 0, 0), Vec3(0, 0, 265), light));
-    
-        auto center1 = Point3(400, 400, 200);
-        auto center2 = center1 + Vec3(30, 0, 0); 
-        auto sphere_material = std::make_shared<Lambertian>(Color3(0.7, 0.3, 0.1));
-        world.add(std::make_shared<Sphere>(center1, center2, 50, sphere_material));
-    
-        world.add(std::make_shared<Sphere>(Point3(260, 150, 45), 50, std::make_shared<Dielectric>(1.5)));
-    
-        world.add(std::make_shared<Sphere>(Point3(0, 150, 145), 50, std::make_shared<Metal>(Color3(0.8, 0.8, 0.9), 1.0)));
-    
-        auto boundary = std::make_shared<Sphere>(Point3(360, 150, 145), 70, std::make_shared<Dielectric>(1.5));
-        world.add(boundary);
-        world.add(std::make_shared<ConstantMedium>(boundary, 0.2, Color3(0.2, 0.4, 0.9)));
-    
-        boundary = std::make_shared<Sphere>(Point3(0, 0, 0), 5000, std::make_shared<Dielectric>(1.5));
-        world.add(std::make_shared<ConstantMedium>(boundary, .0001, Color3(1, 1, 1)));
-    
-        auto earth_texture = std::make_shared<ImageTexture>("earthmap.png");
-        auto earth_mat = std::make_shared<Lambertian>(earth_texture);
-        world.add(std::make_shared<Sphere>(Point3(400, 200, 400), 100, earth_mat));
-    
-        auto pertext = std::make_shared<NoiseTexture>(0.1);
-        world.add(std::make_shared<Sphere>(Point3(220, 280, 300), 80, std::make_shared<Lambertian>(pertext)));
-    
-        HittableList boxes2;
-        auto white = std::make_shared<Lambertian>(Color3(0.73, 0.73, 0.73));
-        int ns = 10;
-        for (int j = 0; j < ns; j++) {
-            boxes2.add(std::make_shared<Sphere>(Point3::random(0, 165), 10, white));
-        }
-    
-        world.add(std::make_shared<Translate>(
-            std::make_shared<RotateY>(
-                std::make_shared<BVHNode>(boxes2), 15),
-                Vec3(-100, 270, 395)
-            )
-        );
-    
-        return world;
+    Scene scene;
+    if (!make_scene(options.scene, aspect_ratio, scene))
+        return 1;
+    const HittableList& world = scene.world;
+    RTCamera& camera = scene.camera;
+
+    if (options.headless) {
+        int spp = options.samples_per_pixel > 0 ? options.samples_per_pixel : 100;
+        std::vector<Color3> buffer = render_headless(screen_width, screen_height, spp, [&](int i, int j) {
+            double u = (i + random_double()) / (screen_width - 1);
+            double v = (j + random_double()) / (screen_height - 1);
+            return ray_color(camera.get_ray(u, 1.0 - v), world, max_depth);
+        });
+        return write_image(options.output, buffer, screen_width, screen_height, spp) ? 0 : 1;
     }
 
-int main() {
     SetConfigFlags(FLAG_WINDOW_HIGHDPI);
-    srand(static_cast<unsigned int>(time(NULL)));
-
-    const int screen_width = 200;
-    const int screen_height = 200;
-    const double aspect_ratio = 1.0;
 
     InitWindow(screen_width, screen_height, "Ray Tracing: The Next Week (Raylib)");
     SetTargetFPS(60);
 
-    int samples_per_pixel = 50; 
-    int max_depth = 8;         
-    bool is_rendering = true;
-    int accumulated_samples = 0;
-
-    Point3 lookfrom(478, 278, -600);
-    Point3 lookat(278, 278, 0);
-    Vec3 vup(0, 1, 0);
-
-    double vfov = 40.0;      
-    double dist_to_focus = 10.0; 
-    double aperture = 0.0;
-
-    RTCamera camera(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
-
-    std::vector<Color3> accumulation_buffer(screen_width * screen_height, Color3(0, 0, 0));
+    AdaptiveSampler sampler(screen_width, screen_height);
+    bool show_density = false;
+    TileScheduler scheduler(screen_width, screen_height);
     Image render_image = GenImageColor(screen_width, screen_height, BLACK);
     Texture2D render_texture = LoadTextureFromImage(render_image);
 
-    HittableList world = final_scene();
-
     float move_speed = 10.0f;
     float mouse_sensitivity = 0.003f;
 
@@ -365,6 +134,9 @@ int main() {
 
         if (IsKeyPressed(KEY_P)) is_rendering = !is_rendering;
         if (IsKeyPressed(KEY_R)) camera_moved = true;
+        if (IsKeyPressed(KEY_T)) scheduler.write_timings(std::cout);
+        if (IsKeyPressed(KEY_M)) sampler.enabled = !sampler.enabled;
+        if (IsKeyPressed(KEY_V)) show_density = !show_density;
         
         if (IsKeyPressed(KEY_EQUAL) || IsKeyPressed(KEY_KP_ADD)) 
             samples_per_pixel = (samples_per_pixel + 1 < 10) ? samples_per_pixel + 1 : 10;
@@ -373,34 +145,73 @@ int main() {
 
         if (camera_moved) {
             accumulated_samples = 0;
-            std::fill(accumulation_buffer.begin(), accumulation_buffer.end(), Color3(0,0,0));
-             for (int j = 0; j < screen_height; j++) {
-                for (int i = 0; i < screen_width; i++) {
-                    double u = (i + 0.5) / (screen_width - 1);
-                    double v = (j + 0.5) / (screen_height - 1);
-                    RTRay r = camera.get_ray(u, 1.0 - v);
-                    accumulation_buffer[j * screen_width + i] = ray_color(r, world, 2);
-                }
-            }
+            sampler.reset();
+            scheduler.run([&](const Tile& tile) {
+                for_each_pixel_block(tile, [&](const PixelBlock& block) {
+                    Pcg32 rng[packet_width];
+                    for (int lane = 0; lane < packet_width; lane++) {
+                        if (!((block.active >> lane) & 1)) continue;
+                        seed_thread_rng(0, block.j(lane) * screen_width + block.i(lane));
+                        rng[lane] = thread_rng();
+                    }
+
+                    Color3 colors[packet_width];
+                    trace_camera_packet(block.active, rng, [&](int lane) {
+                        double u = (block.i(lane) + 0.5) / (screen_width - 1);
+                        double v = (block.j(lane) + 0.5) / (screen_height - 1);
+                        return camera.get_ray(u, 1.0 - v);
+                    }, world, 2, colors);
+
+                    for (int lane = 0; lane < packet_width; lane++)
+                        if ((block.active >> lane) & 1)
+                            sampler.add(block.j(lane) * screen_width + block.i(lane), colors[lane]);
+                });
+            });
             accumulated_samples = 1;
-            buffer_to_image(render_image, accumulation_buffer, screen_width, screen_height, 1);
+            sampler.to_image(render_image, show_density);
             UpdateTexture(render_texture, render_image.data);
         }
         else if (is_rendering) {
-            for (int j = 0; j < screen_height; j++) {
-                for (int i = 0; i < screen_width; i++) {
-                    Color3 pixel_color(0, 0, 0);
-                    for (int s = 0; s < samples_per_pixel; s++) {
-                        double u = (i + random_double()) / (screen_width - 1);
-                        double v = (j + random_double()) / (screen_height - 1);
-                        RTRay r = camera.get_ray(u, 1.0 - v);
-                        pixel_color += ray_color(r, world, max_depth);
+            scheduler.run([&](const Tile& tile) {
+                for_each_pixel_block(tile, [&](const PixelBlock& block) {
+                    // Each lane takes as many samples as the sampler asks of
+                    // its pixel; the packet carries the lanes that still want one.
+                    Pcg32 rng[packet_width];
+                    int wanted[packet_width] = {};
+                    int most = 0;
+                    for (int lane = 0; lane < packet_width; lane++) {
+                        if (!((block.active >> lane) & 1)) continue;
+                        int pixel_index = block.j(lane) * screen_width + block.i(lane);
+                        wanted[lane] = sampler.samples_for(pixel_index, samples_per_pixel);
+                        most = std::max(most, wanted[lane]);
+                        seed_thread_rng(accumulated_samples, pixel_index);
+                        rng[lane] = thread_rng();
+                    }
+
+                    for (int s = 0; s < most; s++) {
+                        int active = 0;
+                        for (int lane = 0; lane < packet_width; lane++)
+                            if (wanted[lane] > s) active |= 1 << lane;
+
+                        Color3 colors[packet_width];
+                        trace_camera_packet(active, rng, [&](int lane) {
+                            double u = (block.i(lane) + random_double()) / (screen_width - 1);
+                            double v = (block.j(lane) + random_double()) / (screen_height - 1);
+                            return camera.get_ray(u, 1.0 - v);
+                        }, world, max_depth, colors);
+
+                        for (int lane = 0; lane < packet_width; lane++)
+                            if ((active >> lane) & 1)
+                                sampler.add(block.j(lane) * screen_width + block.i(lane), colors[lane]);
                     }
-                    accumulation_buffer[j * screen_width + i] += pixel_color;
-                }
-            }
+                });
+            });
             accumulated_samples += samples_per_pixel;
-            buffer_to_image(render_image, accumulation_buffer, screen_width, screen_height, accumulated_samples);
+            sampler.to_image(render_image, show_density);
+            UpdateTexture(render_texture, render_image.data);
+        }
+        else if (IsKeyPressed(KEY_V)) {
+            sampler.to_image(render_image, show_density);
             UpdateTexture(render_texture, render_image.data);
         }
 
@@ -411,6 +222,13 @@ int main() {
         DrawText(TextFormat("FPS: %d", GetFPS()), 10, 10, 20, GREEN);
         DrawText(TextFormat("Samples: %d", accumulated_samples), 10, 35, 20, GREEN);
         DrawText(is_rendering ? "Rendering..." : "PAUSED", 10, 60, 20, is_rendering ? GREEN : RED);
+        DrawText(TextFormat("Threads: %d", render_threads()), 10, 85, 20, GREEN);
+        const TileStats& tiles = scheduler.last_stats();
+        DrawText(TextFormat("Tiles: %d  max %.1f ms  steals %d [T]", tiles.tiles, tiles.max_ms, tiles.steals), 10, 110, 20, GREEN);
+        AdaptiveSampler::Summary spp = sampler.summary(samples_per_pixel);
+        DrawText(TextFormat("Adaptive [M]: %s  active %.0f%%  %.1f spp avg  %d max", sampler.enabled ? "on" : "off",
+                            100 * spp.active, spp.mean_samples, spp.max_samples), 10, 135, 20, GREEN);
+        DrawText(TextFormat("Density view [V]: %s", show_density ? "on" : "off"), 10, 160, 20, GREEN);
         
         EndDrawing();
     }
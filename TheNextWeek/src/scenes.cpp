@@ -0,0 +1,256 @@
+#include "../include/scenes.h"
+#include "../include/scene_file.h"
+#include "../include/material.h"
+#include "../include/bvh.h"
+#include "../include/quad.h"
+#include "../include/transform.h"
+#include "../include/constant_medium.h"
+
+#include <iostream>
+
+    HittableList random_scene() {
+        HittableList world;
+
+        auto checker = std::make_shared<CheckerTexture>(0.32, Color3(0.2, 0.3, 0.1), Color3(0.9, 0.9, 0.9));
+        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(checker)));
+        auto ground_material = std::make_shared<Lambertian>(checker);
+        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
+
+        auto earth_texture = std::make_shared<ImageTexture>("earthmap.png");
+        auto earth_surface = std::make_shared<Lambertian>(earth_texture);
+        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, earth_surface));
+        world.add(std::make_shared<Sphere>(Point3(0, 2, 0), 1.5, earth_surface));
+
+        auto pertext = std::make_shared<NoiseTexture>(4.0);
+        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(pertext)));
+        world.add(std::make_shared<Sphere>(Point3(0, 2, 0), 2, std::make_shared<Lambertian>(pertext)));
+
+        for (int a = -5; a < 5; a++) {
+            for (int b = -5; b < 5; b++) {
+                auto choose_mat = random_double();
+                Point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+                if ((center - Point3(4, 0.2, 0)).length() > 0.9) {
+                    std::shared_ptr<RTMaterial> sphere_material;
+
+                    if (choose_mat < 0.8) {
+                        auto albedo = Color3::random() * Color3::random();
+                        sphere_material = std::make_shared<Lambertian>(albedo);
+                        
+                        auto center2 = center + Vec3(0, random_double(0, 0.5), 0);
+                        world.add(std::make_shared<Sphere>(center, center2, 0.2, sphere_material));
+                    } else if (choose_mat < 0.95) {
+                        auto albedo = Color3::random(0.5, 1);
+                        auto fuzz = random_double(0, 0.5);
+                        sphere_material = std::make_shared<Metal>(albedo, fuzz);
+                        world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
+                    } else {
+                        sphere_material = std::make_shared<Dielectric>(1.5);
+                        world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
+                    }
+                }
+            }
+        }
+
+        auto material1 = std::make_shared<Dielectric>(1.5);
+        world.add(std::make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
+
+        auto material2 = std::make_shared<Lambertian>(Color3(0.4, 0.2, 0.1));
+        world.add(std::make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
+
+        auto material3 = std::make_shared<Metal>(Color3(0.7, 0.6, 0.5), 0.0);
+        world.add(std::make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
+
+        return HittableList(std::make_shared<BVHNode>(world));
+    }
+
+    HittableList quads_scene() {
+        HittableList world;
+    
+        auto left_red     = std::make_shared<Lambertian>(Color3(1.0, 0.2, 0.2));
+        auto back_green   = std::make_shared<Lambertian>(Color3(0.2, 1.0, 0.2));
+        auto right_blue   = std::make_shared<Lambertian>(Color3(0.2, 0.2, 1.0));
+        auto upper_orange = std::make_shared<Lambertian>(Color3(1.0, 0.5, 0.0));
+        auto lower_teal   = std::make_shared<Lambertian>(Color3(0.2, 0.8, 0.8));
+    
+        world.add(std::make_shared<Quad>(Point3(-3,-2, 5), Vec3(0, 0,-4), Vec3(0, 4, 0), left_red));
+        world.add(std::make_shared<Quad>(Point3(-2,-2, 0), Vec3(4, 0, 0), Vec3(0, 4, 0), back_green));
+        world.add(std::make_shared<Quad>(Point3( 3,-2, 1), Vec3(0, 0, 4), Vec3(0, 4, 0), right_blue));
+        world.add(std::make_shared<Quad>(Point3(-2, 3, 1), Vec3(4, 0, 0), Vec3(0, 0, 4), upper_orange));
+        world.add(std::make_shared<Quad>(Point3(-2,-3, 5), Vec3(4, 0, 0), Vec3(0, 0,-4), lower_teal));
+    
+        return world;
+    }
+
+    HittableList simple_light() {
+        HittableList world;
+    
+        auto pertext = std::make_shared<NoiseTexture>(4);
+        world.add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(pertext)));
+        world.add(std::make_shared<Sphere>(Point3(0, 2, 0), 2, std::make_shared<Lambertian>(pertext)));
+    
+        auto difflight = std::make_shared<DiffuseLight>(Color3(4, 4, 4));
+        world.add(std::make_shared<Quad>(Point3(3, 1, -2), Vec3(2, 0, 0), Vec3(0, 2, 0), difflight));
+        world.add(std::make_shared<Sphere>(Point3(0, 7, 0), 2, difflight));
+        return world;
+    }
+
+    std::shared_ptr<HittableList> box(const Point3& a, const Point3& b, std::shared_ptr<RTMaterial> mat) {
+        auto sides = std::make_shared<HittableList>();
+    
+        Point3 min(fmin(a.x, b.x), fmin(a.y, b.y), fmin(a.z, b.z));
+        Point3 max(fmax(a.x, b.x), fmax(a.y, b.y), fmax(a.z, b.z));
+    
+        Vec3 dx(max.x - min.x, 0, 0);
+        Vec3 dy(0, max.y - min.y, 0);
+        Vec3 dz(0, 0, max.z - min.z);
+    
+        sides->add(std::make_shared<Quad>(Point3(min.x, min.y, max.z),  dx,  dy, mat)); 
+        sides->add(std::make_shared<Quad>(Point3(max.x, min.y, max.z), -dz,  dy, mat)); 
+        sides->add(std::make_shared<Quad>(Point3(max.x, min.y, min.z), -dx,  dy, mat)); 
+        sides->add(std::make_shared<Quad>(Point3(min.x, min.y, min.z),  dz,  dy, mat)); 
+        sides->add(std::make_shared<Quad>(Point3(min.x, max.y, max.z),  dx, -dz, mat)); 
+        sides->add(std::make_shared<Quad>(Point3(min.x, min.y, min.z),  dx,  dz, mat));
+    
+        return sides;
+    }
+
+    HittableList cornell_box() {
+        HittableList world;
+    
+        auto red   = std::make_shared<Lambertian>(Color3(0.65, 0.05, 0.05));
+        auto white = std::make_shared<Lambertian>(Color3(0.73, 0.73, 0.73));
+        auto green = std::make_shared<Lambertian>(Color3(0.12, 0.45, 0.15));
+        auto light = std::make_shared<DiffuseLight>(Color3(15, 15, 15)); 
+    
+        
+        world.add(std::make_shared<Quad>(Point3(555, 0, 0), Vec3(0, 555, 0), Vec3(0, 0, 555), green));
+        world.add(std::make_shared<Quad>(Point3(0, 0, 0), Vec3(0, 555, 0), Vec3(0, 0, 555), red));
+        world.add(std::make_shared<Quad>(Point3(343, 554, 332), Vec3(-130, 0, 0), Vec3(0, 0, -105), light));
+        world.add(std::make_shared<Quad>(Point3(0, 0, 0), Vec3(555, 0, 0), Vec3(0, 0, 555), white));
+        world.add(std::make_shared<Quad>(Point3(555, 555, 555), Vec3(-555, 0, 0), Vec3(0, 0, -555), white));
+        world.add(std::make_shared<Quad>(Point3(0, 0, 555), Vec3(555, 0, 0), Vec3(0, 555, 0), white));
+
+
+        world.add(box(Point3(130, 0, 65), Point3(295, 165, 230), white));
+        world.add(box(Point3(265, 0, 295), Point3(430, 330, 460), white));
+
+        std::shared_ptr<Hittable> box1 = box(Point3(0, 0, 0), Point3(165, 330, 165), white);
+        box1 = std::make_shared<RotateY>(box1, 15);
+        box1 = std::make_shared<Translate>(box1, Vec3(265, 0, 295));
+
+        std::shared_ptr<Hittable> box2 = box(Point3(0, 0, 0), Point3(165, 165, 165), white);
+        box2 = std::make_shared<RotateY>(box2, -18);
+        box2 = std::make_shared<Translate>(box2, Vec3(130, 0, 65));
+
+        world.add(std::make_shared<ConstantMedium>(box1, 0.01, Color3(0, 0, 0))); 
+        world.add(std::make_shared<ConstantMedium>(box2, 0.01, Color3(1, 1, 1)));
+
+    return world;
+    }
+
+    HittableList final_scene() {
+        HittableList boxes1;
+        auto ground = std::make_shared<Lambertian>(Color3(0.48, 0.83, 0.53));
+        int boxes_per_side = 5;
+        for (int i = 0; i < boxes_per_side; i++) {
+            for (int j = 0; j < boxes_per_side; j++) {
+                auto w = 100.0;
+                auto x0 = -1000.0 + i * w;
+                auto z0 = -1000.0 + j * w;
+                auto y0 = 0.0;
+                auto x1 = x0 + w;
+                auto y1 = random_double(1, 101); 
+                auto z1 = z0 + w;
+    
+                boxes1.add(box(Point3(x0, y0, z0), Point3(x1, y1, z1), ground));
+            }
+        }
+        HittableList world;
+    
+        auto ground_bvh = std::make_shared<BVHNode>(boxes1, BVHBuildMode::parallel);
+        std::clog << "BVH (ground boxes): " << ground_bvh->build_stats() << '\n';
+        world.add(ground_bvh);
+    
+        auto light = std::make_shared<DiffuseLight>(Color3(7, 7, 7));
+        world.add(std::make_shared<Quad>(Point3(123, 554, 147), Vec3(300, 0, 0), Vec3(0, 0, 265), light));
+    
+        auto center1 = Point3(400, 400, 200);
+        auto center2 = center1 + Vec3(30, 0, 0); 
+        auto sphere_material = std::make_shared<Lambertian>(Color3(0.7, 0.3, 0.1));
+        world.add(std::make_shared<Sphere>(center1, center2, 50, sphere_material));
+    
+        world.add(std::make_shared<Sphere>(Point3(260, 150, 45), 50, std::make_shared<Dielectric>(1.5)));
+    
+        world.add(std::make_shared<Sphere>(Point3(0, 150, 145), 50, std::make_shared<Metal>(Color3(0.8, 0.8, 0.9), 1.0)));
+    
+        auto boundary = std::make_shared<Sphere>(Point3(360, 150, 145), 70, std::make_shared<Dielectric>(1.5));
+        world.add(boundary);
+        world.add(std::make_shared<ConstantMedium>(boundary, 0.2, Color3(0.2, 0.4, 0.9)));
+    
+        boundary = std::make_shared<Sphere>(Point3(0, 0, 0), 5000, std::make_shared<Dielectric>(1.5));
+        world.add(std::make_shared<ConstantMedium>(boundary, .0001, Color3(1, 1, 1)));
+    
+        auto earth_texture = std::make_shared<ImageTexture>("earthmap.png");
+        auto earth_mat = std::make_shared<Lambertian>(earth_texture);
+        world.add(std::make_shared<Sphere>(Point3(400, 200, 400), 100, earth_mat));
+    
+        auto pertext = std::make_shared<NoiseTexture>(0.1);
+        world.add(std::make_shared<Sphere>(Point3(220, 280, 300), 80, std::make_shared<Lambertian>(pertext)));
+    
+        HittableList boxes2;
+        auto white = std::make_shared<Lambertian>(Color3(0.73, 0.73, 0.73));
+        int ns = 10;
+        for (int j = 0; j < ns; j++) {
+            boxes2.add(std::make_shared<Sphere>(Point3::random(0, 165), 10, white));
+        }
+    
+        world.add(std::make_shared<Translate>(
+            std::make_shared<RotateY>(
+                std::make_shared<BVHNode>(boxes2), 15),
+                Vec3(-100, 270, 395)
+            )
+        );
+    
+        return world;
+    }
+
+bool make_scene(const std::string& name, double aspect_ratio, Scene& scene) {
+    Point3 lookfrom(478, 278, -600);
+    Point3 lookat(278, 278, 0);
+    double vfov = 40.0;
+
+    if (is_scene_file(name))
+        return load_scene_file(name, aspect_ratio, scene);
+
+    if (name.empty() || name == "final") {
+        scene.world = final_scene();
+    } else if (name == "random") {
+        scene.world = random_scene();
+        lookfrom = Point3(13, 2, 3);
+        lookat = Point3(0, 0, 0);
+        vfov = 20.0;
+    } else if (name == "quads") {
+        scene.world = quads_scene();
+        lookfrom = Point3(0, 0, 9);
+        lookat = Point3(0, 0, 0);
+        vfov = 80.0;
+    } else if (name == "simple_light") {
+        scene.world = simple_light();
+        lookfrom = Point3(26, 3, 6);
+        lookat = Point3(0, 2, 0);
+        vfov = 20.0;
+    } else if (name == "cornell") {
+        scene.world = cornell_box();
+        lookfrom = Point3(278, 278, -800);
+    } else {
+        std::cerr << "ERROR: Unknown scene '" << name << "' (available: final, random, quads, simple_light, cornell, or a .scene file).\n";
+        return false;
+    }
+
+    Vec3 vup(0, 1, 0);
+    double dist_to_focus = 10.0; 
+    double aperture = 0.0;
+    scene.camera = RTCamera(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
+    return true;
+}
@@ -0,0 +1,288 @@
+#include "kernels.h"
+
+#include "rtweekend.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "camera.h"
+#include "hittable.h"
+#include "material.h"
+#include "quad.h"
+#include "transform.h"
+#include "constant_medium.h"
+#include "perlin.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace {
+
+const uint64_t kernel_seed = 0x6b65726e;
+
+// Written after each timing loop so the calls cannot be optimised away.
+volatile double kernel_sink = 0;
+
+// Rays start on a sphere of radius `distance` around `center`. A `hit_rate`
+// fraction aims at a point produced by `inside()` (on or in the shape, so a
+// convex target is always hit); the rest head away from `center` and always
+// miss anything closer to it than `distance`.
+template <typename Inside>
+std::vector<RTRay> make_rays(const KernelOptions& options, const Point3& center, double distance, const Inside& inside) {
+    std::vector<RTRay> rays;
+    rays.reserve(options.rays);
+    for (int k = 0; k < options.rays; ++k) {
+        Point3 origin = center + distance * random_unit_vector();
+        Vec3 direction;
+        if (random_double() < options.hit_rate)
+            direction = inside() - origin;
+        else
+            direction = (origin - center) + 0.5 * random_unit_vector();
+        rays.push_back(RTRay(origin, direction));
+    }
+    return rays;
+}
+
+// Every kernel finishes the records it fills, as the renderer does for the
+// closest hit, and folds them into this sum: with -fno-math-errno the
+// compiler may otherwise see that a record is never read and drop the work
+// that only feeds it, such as a sphere's texture coordinates.
+double record_sum = 0;
+
+bool consume(bool hit, const RTRay& r, HitRecord& rec) {
+    if (hit) {
+        finish_hit(r, rec);
+        record_sum += rec.t + rec.u + rec.v + rec.normal.x;
+    }
+    return hit;
+}
+
+// Packs `rays` into packets of packet_width, repeating the last ray to fill
+// the final packet.
+std::vector<RayPacket<packet_width>> make_packets(const std::vector<RTRay>& rays) {
+    std::vector<RayPacket<packet_width>> packets((rays.size() + packet_width - 1) / packet_width);
+    for (size_t k = 0; k < packets.size() * packet_width; ++k)
+        packets[k / packet_width].set(int(k % packet_width), rays[std::min(k, rays.size() - 1)]);
+    return packets;
+}
+
+const int all_lanes = (1 << packet_width) - 1;
+
+// Number of set bits among the lanes of packet `k` that hold real rays.
+int count_hits(int mask, int k, const KernelOptions& options) {
+    int lanes = std::min(packet_width, options.rays - k);
+    int hits = 0;
+    for (int i = 0; i < lanes; ++i)
+        hits += (mask >> i) & 1;
+    return hits;
+}
+
+// Runs `call(k)` for k = 0, lanes, 2 * lanes, ... over the whole batch until
+// at least options.min_ms has passed; `call` returns how many of elements
+// k..k+lanes-1 hit. Times are per element, so packet kernels (lanes > 1)
+// compare directly with their one-ray versions.
+template <typename Call>
+KernelResult time_kernel(const char* name, const KernelOptions& options, double target_hit_rate, const Call& call,
+                         int lanes = 1) {
+    size_t calls = 0;
+    size_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    double ms = 0;
+    do {
+        for (int k = 0; k < options.rays; k += lanes)
+            hits += call(k);
+        calls += options.rays;
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    } while (ms < options.min_ms);
+    kernel_sink = double(hits);
+
+    KernelResult result;
+    result.kernel = name;
+    result.batch = options.rays;
+    result.target_hit_rate = target_hit_rate;
+    result.hit_rate = double(hits) / calls;
+    result.ns_per_call = ms * 1e6 / calls;
+    result.mcalls_per_s = calls / (ms * 1e3);
+    return result;
+}
+
+} // namespace
+
+std::vector<KernelResult> run_kernel_benchmarks(const KernelOptions& options) {
+    seed_thread_rng(kernel_seed);
+
+    std::vector<KernelResult> results;
+    const interval ray_t(0.001, infinity);
+    const double distance = 4.0;
+    auto white = std::make_shared<Lambertian>(Color3(0.73, 0.73, 0.73));
+
+    auto in_unit_sphere = []() { return 0.99 * random_double() * random_unit_vector(); };
+    auto sphere = std::make_shared<Sphere>(Point3(0, 0, 0), 1.0, white);
+    {
+        std::vector<RTRay> rays = make_rays(options, Point3(0, 0, 0), distance, in_unit_sphere);
+        Sphere ball(Point3(0, 0, 0), 1.0, white);
+        HitRecord rec{};
+        results.push_back(time_kernel("sphere", options, options.hit_rate, [&](int k) {
+            return consume(ball.hit(rays[k], ray_t, rec), rays[k], rec);
+        }));
+        results.push_back(time_kernel("sphere_occluded", options, options.hit_rate, [&](int k) {
+            return ball.occluded(rays[k], ray_t);
+        }));
+
+        std::vector<RayPacket<packet_width>> packets = make_packets(rays);
+        HitRecord recs[packet_width]{};
+        results.push_back(time_kernel("sphere_packet", options, options.hit_rate, [&](int k) {
+            real t_max[packet_width];
+            for (real& t : t_max) t = ray_t.max;
+            int mask = ball.hit_packet(packets[k / packet_width], all_lanes, ray_t, t_max, recs);
+            for (int i = 0; i < packet_width; ++i)
+                consume((mask >> i) & 1, rays[std::min<size_t>(k + i, rays.size() - 1)], recs[i]);
+            return count_hits(mask, k, options);
+        }, packet_width));
+    }
+    {
+        Quad quad(Point3(-1, -1, 0), Vec3(2, 0, 0), Vec3(0, 2, 0), white);
+        std::vector<RTRay> rays = make_rays(options, Point3(0, 0, 0), distance, []() {
+            return Point3(random_double(-0.99, 0.99), random_double(-0.99, 0.99), 0);
+        });
+        HitRecord rec{};
+        results.push_back(time_kernel("quad", options, options.hit_rate, [&](int k) {
+            return consume(quad.hit(rays[k], ray_t, rec), rays[k], rec);
+        }));
+        results.push_back(time_kernel("quad_occluded", options, options.hit_rate, [&](int k) {
+            return quad.occluded(rays[k], ray_t);
+        }));
+
+        std::vector<RayPacket<packet_width>> packets = make_packets(rays);
+        HitRecord recs[packet_width]{};
+        results.push_back(time_kernel("quad_packet", options, options.hit_rate, [&](int k) {
+            real t_max[packet_width];
+            for (real& t : t_max) t = ray_t.max;
+            int mask = quad.hit_packet(packets[k / packet_width], all_lanes, ray_t, t_max, recs);
+            for (int i = 0; i < packet_width; ++i)
+                consume((mask >> i) & 1, rays[std::min<size_t>(k + i, rays.size() - 1)], recs[i]);
+            return count_hits(mask, k, options);
+        }, packet_width));
+    }
+    {
+        AABB box(Point3(-1, -1, -1), Point3(1, 1, 1));
+        std::vector<RTRay> rays = make_rays(options, Point3(0, 0, 0), distance, []() {
+            return Point3(random_double(-0.99, 0.99), random_double(-0.99, 0.99), random_double(-0.99, 0.99));
+        });
+        results.push_back(time_kernel("aabb", options, options.hit_rate, [&](int k) {
+            return box.hit(rays[k], ray_t);
+        }));
+    }
+    {
+        // A 10x10x10 grid of small spheres under a BVH. Rays aimed into the
+        // grid can pass between the spheres, so the hit rate is below the
+        // target. "bvh_occluded" may stop at the first sphere it finds.
+        HittableList grid;
+        for (int x = 0; x < 10; x++)
+            for (int y = 0; y < 10; y++)
+                for (int z = 0; z < 10; z++)
+                    grid.add(std::make_shared<Sphere>(Point3(-0.9 + 0.2 * x, -0.9 + 0.2 * y, -0.9 + 0.2 * z), 0.08, white));
+        BVHNode bvh(grid);
+        std::vector<RTRay> rays = make_rays(options, Point3(0, 0, 0), distance, []() {
+            return Point3(random_double(-1, 1), random_double(-1, 1), random_double(-1, 1));
+        });
+        HitRecord rec{};
+        results.push_back(time_kernel("bvh", options, options.hit_rate, [&](int k) {
+            return consume(bvh.hit(rays[k], ray_t, rec), rays[k], rec);
+        }));
+        results.push_back(time_kernel("bvh_occluded", options, options.hit_rate, [&](int k) {
+            return bvh.occluded(rays[k], ray_t);
+        }));
+    }
+    {
+        // Primary ray generation for a pinhole camera over a 256x256 grid;
+        // nothing is hit, so the hit rate is 0.
+        RTCamera camera(Point3(0, 0, 0), Point3(0, 0, -1), Vec3(0, 1, 0), 40, 1.0);
+        auto grid = [](int k) { return real(k & 255) / 256; };
+        real sink = 0;
+        results.push_back(time_kernel("camera", options, 0, [&](int k) {
+            RTRay r = camera.get_ray(grid(k), grid(k >> 8));
+            sink += r.origin.x + r.direction.x + r.direction.y + r.direction.z;
+            return 0;
+        }));
+        RayPacket<packet_width> packet;
+        results.push_back(time_kernel("camera_packet", options, 0, [&](int k) {
+            real s[packet_width], t[packet_width];
+            for (int i = 0; i < packet_width; ++i) {
+                s[i] = grid(k + i);
+                t[i] = grid((k + i) >> 8);
+            }
+            camera.get_rays<packet_width>(s, t, packet);
+            for (int i = 0; i < packet_width; ++i)
+                sink += packet.origin.x[i] + packet.direction.x[i] + packet.direction.y[i] + packet.direction.z[i];
+            return 0;
+        }, packet_width));
+        kernel_sink = sink;
+    }
+    {
+        // A sphere at the pivot is rotation invariant, so the same ray batch
+        // applies and the difference to "sphere" is the transform overhead.
+        RotateY rotated(sphere, 30);
+        std::vector<RTRay> rays = make_rays(options, Point3(0, 0, 0), distance, in_unit_sphere);
+        HitRecord rec{};
+        results.push_back(time_kernel("rotate_y", options, options.hit_rate, [&](int k) {
+            return consume(rotated.hit(rays[k], ray_t, rec), rays[k], rec);
+        }));
+    }
+    {
+        Vec3 offset(1, 2, 3);
+        Translate moved(sphere, offset);
+        std::vector<RTRay> rays = make_rays(options, offset, distance, [&]() { return offset + in_unit_sphere(); });
+        HitRecord rec{};
+        results.push_back(time_kernel("translate", options, options.hit_rate, [&](int k) {
+            return consume(moved.hit(rays[k], ray_t, rec), rays[k], rec);
+        }));
+    }
+    {
+        // Rays aimed into the medium still pass through it unscattered with
+        // probability exp(-density * chord), so the measured hit rate is
+        // below the target.
+        ConstantMedium medium(sphere, 1.0, Color3(1, 1, 1));
+        std::vector<RTRay> rays = make_rays(options, Point3(0, 0, 0), distance, in_unit_sphere);
+        HitRecord rec{};
+        results.push_back(time_kernel("constant_medium", options, options.hit_rate, [&](int k) {
+            return consume(medium.hit(rays[k], ray_t, rec), rays[k], rec);
+        }));
+    }
+    {
+        Perlin noise;
+        std::vector<Point3> points;
+        points.reserve(options.rays);
+        for (int k = 0; k < options.rays; ++k)
+            points.push_back(Point3::random(-10, 10));
+        double sum = 0;
+        // Not an intersection: the reported hit rate is the fraction of
+        // samples with turbulence above 0.5.
+        results.push_back(time_kernel("perlin_turb", options, 0, [&](int k) {
+            double t = noise.turb(points[k], 7);
+            sum += t;
+            return t > 0.5;
+        }));
+        kernel_sink = sum;
+    }
+
+    kernel_sink = record_sum;
+    return results;
+}
+
+void write_kernel_json(std::ostream& out, const std::vector<KernelResult>& results) {
+    out << "[\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const KernelResult& r = results[k];
+        out << "    {\n"
+            << "      \"kernel\": \"" << r.kernel << "\",\n"
+            << "      \"batch\": " << r.batch << ",\n"
+            << "      \"target_hit_rate\": " << r.target_hit_rate << ",\n"
+            << "      \"hit_rate\": " << r.hit_rate << ",\n"
+            << "      \"ns_per_call\": " << r.ns_per_call << ",\n"
+            << "      \"mcalls_per_s\": " << r.mcalls_per_s << "\n"
+            << "    }" << (k + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]";
+}
@@ -4,74 +4,540 @@
 
 #include "aabb.h"
 #include "hittable.h"
+#include "parallel.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <memory>
+#include <numeric>
+#include <ostream>
+#include <thread>
 #include <vector>
 
 
-class BVHNode : public Hittable {
+// One BVH node in the flattened, depth-first array. The first child of an
+// interior node is always the next node in the array, so only the second child
+// needs an index. Leaves reference a contiguous run of primitives instead.
+struct BVHLinearNode {
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t offset;            // leaf: first primitive, interior: second child
+    uint16_t primitive_count;   // 0 for interior nodes
+    uint8_t axis;
+    uint8_t pad;
+};
+
+static_assert(sizeof(BVHLinearNode) == 32, "BVHLinearNode should stay 32 bytes");
+
+
+enum class BVHBuildMode {
+    serial,
+    parallel
+};
+
+struct BVHBuildStats {
+    size_t primitive_count = 0;
+    size_t node_count = 0;
+    size_t leaf_count = 0;
+    int threads = 1;
+    double build_ms = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const BVHBuildStats& stats) {
+    return out << stats.primitive_count << " primitives, " << stats.node_count << " nodes ("
+               << stats.leaf_count << " leaves), " << stats.build_ms << " ms on "
+               << stats.threads << (stats.threads == 1 ? " thread" : " threads");
+}
+
+
+class LinearBVH {
   public:
-    BVHNode(const HittableList& list) : BVHNode(list.objects, 0, list.objects.size()) {}
+    std::vector<BVHLinearNode> nodes;
+    std::vector<uint32_t> primitive_order;
+
+    BVHBuildStats stats;
+
+    // Entries on the traversal stacks, which bounds how deep a tree can be
+    // walked. Built trees stay well inside it (max_sah_depth).
+    static const int traversal_stack_size = 64;
+
+    void build(const std::vector<AABB>& boxes, BVHBuildMode mode = BVHBuildMode::serial) {
+        auto start_time = std::chrono::steady_clock::now();
+
+        nodes.clear();
+        primitive_order.resize(boxes.size());
+        std::iota(primitive_order.begin(), primitive_order.end(), 0);
+        stats = BVHBuildStats();
+        stats.primitive_count = boxes.size();
+
+        if (!boxes.empty()) {
+            std::vector<Point3> centroids(boxes.size());
+            for (size_t i = 0; i < boxes.size(); i++)
+                centroids[i] = centroid(boxes[i]);
+
+            if (mode == BVHBuildMode::parallel && boxes.size() >= parallel_grain) {
+                int spawn_depth = 0;
+                while ((1 << spawn_depth) < 2 * render_threads())
+                    spawn_depth++;
+                nodes = build_parallel(boxes, centroids, 0, boxes.size(), 0, spawn_depth, stats.threads);
+            } else {
+                nodes.reserve(2 * boxes.size());
+                build_recursive(nodes, boxes, centroids, 0, boxes.size(), 0);
+                nodes.shrink_to_fit();
+            }
+        }
+
+        stats.node_count = nodes.size();
+        for (const auto& node : nodes)
+            if (node.primitive_count > 0) stats.leaf_count++;
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+        stats.build_ms = elapsed.count();
+    }
+
+    // Visits the leaves pierced by the ray, near child first. hit_primitive(index, ray_t)
+    // tests the primitive at `index` in build order and must shrink ray_t.max on a hit.
+    template <typename HitPrimitive>
+    bool traverse(const RTRay& r, interval ray_t, const HitPrimitive& hit_primitive) const {
+        return traverse_nodes(nodes.data(), nodes.size(), r, ray_t, hit_primitive);
+    }
+
+    // Like traverse(), but returns true as soon as hit_primitive reports a
+    // hit, for rays that only ask whether anything is in the way.
+    template <typename HitPrimitive>
+    bool occluded(const RTRay& r, interval ray_t, const HitPrimitive& hit_primitive) const {
+        return traverse_nodes<true>(nodes.data(), nodes.size(), r, ray_t, hit_primitive);
+    }
+
+    // traverse() over any flattened node array, e.g. one mapped straight from
+    // a mesh cache file. With `any_hit` it stops at the first hit.
+    template <bool any_hit = false, typename HitPrimitive>
+    static bool traverse_nodes(const BVHLinearNode* nodes, size_t node_count, const RTRay& r, interval ray_t,
+                               const HitPrimitive& hit_primitive) {
+        if (node_count == 0)
+            return false;
+
+        uint32_t stack[traversal_stack_size];
+        int stack_size = 0;
+        uint32_t current = 0;
+        bool hit_anything = false;
+
+        while (true) {
+            const BVHLinearNode& node = nodes[current];
+
+            if (hit_bounds(node, r, ray_t)) {
+                if (node.primitive_count > 0) {
+                    for (uint32_t i = 0; i < node.primitive_count; i++) {
+                        if (hit_primitive(node.offset + i, ray_t)) {
+                            if (any_hit) return true;
+                            hit_anything = true;
+                        }
+                    }
+                    if (stack_size == 0) break;
+                    current = stack[--stack_size];
+                } else if (r.sign[node.axis]) {
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+            } else {
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            }
+        }
+
+        return hit_anything;
+    }
+
+    // Packet version of traverse() for coherent rays, such as the camera rays
+    // of neighbouring pixels. A node is entered if any active lane pierces
+    // it, and only those lanes carry on below it; children are visited in the
+    // order the first active lane would take. hit_primitive(index, lanes)
+    // tests the primitive at `index` against `lanes`, must lower t_max[i] for
+    // every lane i it hits and returns those lanes. Returns all lanes hit.
+    template <int N, typename HitPrimitive>
+    int traverse_packet(const RayPacket<N>& rays, int active, real ray_tmin, const real t_max[N],
+                        const HitPrimitive& hit_primitive) const {
+        if (nodes.empty() || active == 0)
+            return 0;
+
+        Vec3xN<N> inv_direction;
+        for (int i = 0; i < N; i++) {
+            inv_direction.x[i] = 1 / rays.direction.x[i];
+            inv_direction.y[i] = 1 / rays.direction.y[i];
+            inv_direction.z[i] = 1 / rays.direction.z[i];
+        }
+
+        int lead = 0;
+        while (!((active >> lead) & 1))
+            lead++;
+        const bool lead_negative[3] = {
+            inv_direction.x[lead] < 0, inv_direction.y[lead] < 0, inv_direction.z[lead] < 0
+        };
+
+        struct Entry {
+            uint32_t node;
+            int lanes;
+        };
+        Entry stack[traversal_stack_size];
+        int stack_size = 0;
+        stack[stack_size++] = {0, active};
+        int hit_lanes = 0;
+
+        while (stack_size > 0) {
+            Entry entry = stack[--stack_size];
+            const BVHLinearNode& node = nodes[entry.node];
+
+            int lanes = entry.lanes & hit_bounds(node, rays, inv_direction, ray_tmin, t_max);
+            if (lanes == 0)
+                continue;
+
+            if (node.primitive_count > 0) {
+                for (uint32_t i = 0; i < node.primitive_count; i++)
+                    hit_lanes |= hit_primitive(node.offset + i, lanes);
+            } else if (lead_negative[node.axis]) {
+                stack[stack_size++] = {entry.node + 1, lanes};
+                stack[stack_size++] = {node.offset, lanes};
+            } else {
+                stack[stack_size++] = {node.offset, lanes};
+                stack[stack_size++] = {entry.node + 1, lanes};
+            }
+        }
+
+        return hit_lanes;
+    }
+
+  private:
+    static Point3 centroid(const AABB& box) {
+        return Point3(0.5 * (box.x.min + box.x.max),
+                      0.5 * (box.y.min + box.y.max),
+                      0.5 * (box.z.min + box.z.max));
+    }
 
-    BVHNode(const std::vector<std::shared_ptr<Hittable>>& src_objects, size_t start, size_t end) {
-        auto objects = src_objects;
+    static const int sah_bins = 16;
+    static const size_t max_leaf_primitives = 4;
+    static const int max_sah_depth = 32;
 
-        int axis = random_int(0, 2);
+    struct SahSplit {
+        int axis = -1;
+        int bin = 0;
+        double cost = infinity;
+    };
 
-        auto comparator = (axis == 0) ? box_x_compare
-                        : (axis == 1) ? box_y_compare
-                        : box_z_compare;
+    static const size_t parallel_grain = 4096;
+
+    // Chooses how to split [start, end) and partitions primitive_order to match.
+    // Returns the split point, or `start` when the range should become a leaf.
+    size_t partition_range(const std::vector<AABB>& boxes, const std::vector<Point3>& centroids,
+                           size_t start, size_t end, int depth, BVHLinearNode& node) {
+        AABB bbox;
+        AABB centroid_bounds;
+        for (size_t i = start; i < end; i++) {
+            bbox = AABB(bbox, boxes[primitive_order[i]]);
+            centroid_bounds = AABB(centroid_bounds, AABB(centroids[primitive_order[i]], centroids[primitive_order[i]]));
+        }
+
+        set_bounds(node, bbox);
+        node.pad = 0;
 
         size_t object_span = end - start;
+        size_t mid = start;
+        int axis = centroid_bounds.longest_axis();
+
+        if (object_span > 1 && depth < max_sah_depth) {
+            SahSplit split = find_sah_split(boxes, centroids, bbox, centroid_bounds, start, end);
+            double leaf_cost = double(object_span);
+
+            if (split.axis >= 0 && (object_span > max_leaf_primitives || split.cost < leaf_cost)) {
+                axis = split.axis;
+                const interval& extent = centroid_bounds.axis(axis);
+                mid = std::partition(primitive_order.begin() + start, primitive_order.begin() + end,
+                                     [&](uint32_t prim) {
+                                         return bin_index(centroids[prim][axis], extent) <= split.bin;
+                                     }) - primitive_order.begin();
+            }
+        }
+
+        // Fall back to a median split when SAH finds nothing useful for an oversized
+        // leaf (all centroids coincide) or the tree is getting too deep for the
+        // traversal stack.
+        bool needs_split = object_span > max_leaf_primitives || (depth >= max_sah_depth && object_span > 1);
+        if ((mid == start || mid == end) && needs_split) {
+            mid = start + object_span / 2;
+            std::nth_element(primitive_order.begin() + start, primitive_order.begin() + mid,
+                             primitive_order.begin() + end, [&](uint32_t a, uint32_t b) {
+                                 return centroids[a][axis] < centroids[b][axis];
+                             });
+        }
+
+        if (mid == start || mid == end) {
+            node.offset = uint32_t(start);
+            node.primitive_count = uint16_t(object_span);
+            node.axis = 0;
+            return start;
+        }
 
-        if (object_span == 1) {
-            left = right = objects[start];
-        } else if (object_span == 2) {
-            left = objects[start];
-            right = objects[start+1];
-        } else {
-            std::sort(objects.begin() + start, objects.begin() + end, comparator);
+        node.primitive_count = 0;
+        node.axis = uint8_t(axis);
+        return mid;
+    }
+
+    uint32_t build_recursive(std::vector<BVHLinearNode>& out, const std::vector<AABB>& boxes,
+                             const std::vector<Point3>& centroids, size_t start, size_t end, int depth) {
+        uint32_t index = uint32_t(out.size());
+        out.emplace_back();
+
+        BVHLinearNode node;
+        size_t mid = partition_range(boxes, centroids, start, end, depth, node);
+        if (mid != start) {
+            build_recursive(out, boxes, centroids, start, mid, depth + 1);
+            node.offset = build_recursive(out, boxes, centroids, mid, end, depth + 1);
+        }
+
+        out[index] = node;
+        return index;
+    }
+
+    // Builds the two halves of each of the top `spawn_depth` levels on separate
+    // threads. Each subtree is laid out in its own array and spliced behind its
+    // parent afterwards, so only those top levels are ever copied. `threads` is
+    // set to the number of threads the range was actually built on: ranges
+    // below parallel_grain stay on the calling thread.
+    std::vector<BVHLinearNode> build_parallel(const std::vector<AABB>& boxes, const std::vector<Point3>& centroids,
+                                              size_t start, size_t end, int depth, int spawn_depth, int& threads) {
+        std::vector<BVHLinearNode> out;
+        threads = 1;
+        if (spawn_depth == 0 || end - start < parallel_grain) {
+            out.reserve(2 * (end - start));
+            build_recursive(out, boxes, centroids, start, end, depth);
+            return out;
+        }
+
+        BVHLinearNode node;
+        size_t mid = partition_range(boxes, centroids, start, end, depth, node);
+        if (mid == start) {
+            out.push_back(node);
+            return out;
+        }
+
+        std::vector<BVHLinearNode> left;
+        int left_threads = 1;
+        int right_threads = 1;
+        std::thread worker([&]() {
+            left = build_parallel(boxes, centroids, start, mid, depth + 1, spawn_depth - 1, left_threads);
+        });
+        std::vector<BVHLinearNode> right =
+            build_parallel(boxes, centroids, mid, end, depth + 1, spawn_depth - 1, right_threads);
+        worker.join();
+        threads = left_threads + right_threads;
+
+        out.reserve(1 + left.size() + right.size());
+        node.offset = uint32_t(1 + left.size());
+        out.push_back(node);
+        append_subtree(out, left);
+        append_subtree(out, right);
+        return out;
+    }
+
+    static void append_subtree(std::vector<BVHLinearNode>& out, const std::vector<BVHLinearNode>& subtree) {
+        uint32_t base = uint32_t(out.size());
+        for (BVHLinearNode node : subtree) {
+            if (node.primitive_count == 0)
+                node.offset += base;
+            out.push_back(node);
+        }
+    }
+
+    static int bin_index(double c, const interval& extent) {
+        int bin = int(sah_bins * ((c - extent.min) / extent.size()));
+        return bin < 0 ? 0 : (bin >= sah_bins ? sah_bins - 1 : bin);
+    }
+
+    // Binned surface area heuristic: bucket centroids into sah_bins slots per
+    // axis and sweep the bucket boundaries for the cheapest split.
+    SahSplit find_sah_split(const std::vector<AABB>& boxes, const std::vector<Point3>& centroids,
+                            const AABB& parent, const AABB& centroid_bounds, size_t start, size_t end) const {
+        SahSplit best;
+        double parent_area = parent.surface_area();
+
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& extent = centroid_bounds.axis(axis);
+            if (!(extent.size() > 0))
+                continue;
+
+            size_t counts[sah_bins] = {};
+            AABB bounds[sah_bins];
+            for (size_t i = start; i < end; i++) {
+                uint32_t prim = primitive_order[i];
+                int b = bin_index(centroids[prim][axis], extent);
+                counts[b]++;
+                bounds[b] = AABB(bounds[b], boxes[prim]);
+            }
+
+            double right_area[sah_bins];
+            size_t right_count[sah_bins];
+            AABB right;
+            size_t count = 0;
+            for (int b = sah_bins - 1; b > 0; b--) {
+                right = AABB(right, bounds[b]);
+                count += counts[b];
+                right_area[b] = right.surface_area();
+                right_count[b] = count;
+            }
+
+            AABB left;
+            count = 0;
+            for (int b = 0; b < sah_bins - 1; b++) {
+                left = AABB(left, bounds[b]);
+                count += counts[b];
+                if (count == 0 || right_count[b + 1] == 0)
+                    continue;
+
+                double cost = 0.125 + (count * left.surface_area() + right_count[b + 1] * right_area[b + 1]) / parent_area;
+                if (cost < best.cost) {
+                    best.axis = axis;
+                    best.bin = b;
+                    best.cost = cost;
+                }
+            }
+        }
+
+        return best;
+    }
 
-            size_t mid = start + object_span / 2;
-            left = make_shared<BVHNode>(objects, start, mid);
-            right = make_shared<BVHNode>(objects, mid, end);
+    // Bounds are stored in float and rounded outwards. Flat slabs (axis-aligned
+    // quads) are also widened to min_slab_width: one float ulp around 0 is a
+    // denormal, and entry and exit distances computed from such a slab round
+    // to the same double, so hit_bounds() would reject every ray through it.
+    static constexpr double min_slab_width = 0.0001;
+
+    static void set_bounds(BVHLinearNode& node, const AABB& bbox) {
+        for (int a = 0; a < 3; a++) {
+            const interval& ax = bbox.axis(a);
+            double pad = ax.size() >= 0 && ax.size() < min_slab_width ? 0.5 * (min_slab_width - ax.size()) : 0.0;
+            node.bounds_min[a] = std::nextafter(float(ax.min - pad), -INFINITY);
+            node.bounds_max[a] = std::nextafter(float(ax.max + pad), INFINITY);
         }
     }
 
-        virtual bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
-            if (!bbox.hit(r, ray_t))
+    static bool hit_bounds(const BVHLinearNode& node, const RTRay& r, interval ray_t) {
+        const float* bounds[2] = { node.bounds_min, node.bounds_max };
+        for (int a = 0; a < 3; a++) {
+            auto t0 = (bounds[r.sign[a]][a] - r.origin[a]) * r.inv_direction[a];
+            auto t1 = (bounds[1 - r.sign[a]][a] - r.origin[a]) * r.inv_direction[a];
+
+            if (t0 > ray_t.min) ray_t.min = t0;
+            if (t1 < ray_t.max) ray_t.max = t1;
+
+            if (ray_t.max <= ray_t.min)
                 return false;
+        }
+        return true;
+    }
 
-            bool hit_left = left->hit(r, ray_t, rec);
-            bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
-                return hit_left || hit_right;
+    // The slab test of hit_bounds() for every lane of a packet; returns the
+    // lanes whose (ray_tmin, t_max[i]) overlaps the node's box.
+    template <int N>
+    static int hit_bounds(const BVHLinearNode& node, const RayPacket<N>& rays, const Vec3xN<N>& inv_direction,
+                          real ray_tmin, const real t_max[N]) {
+        real enter[N], leave[N];
+        RT_LANE_LOOP
+        for (int i = 0; i < N; i++) {
+            const real origin[3] = {rays.origin.x[i], rays.origin.y[i], rays.origin.z[i]};
+            const real inv[3] = {inv_direction.x[i], inv_direction.y[i], inv_direction.z[i]};
+            real t_min = ray_tmin;
+            real t_max_lane = t_max[i];
+            for (int a = 0; a < 3; a++) {
+                real ta = (node.bounds_min[a] - origin[a]) * inv[a];
+                real tb = (node.bounds_max[a] - origin[a]) * inv[a];
+                real t0 = inv[a] < 0 ? tb : ta;
+                real t1 = inv[a] < 0 ? ta : tb;
+                t_min = t0 > t_min ? t0 : t_min;
+                t_max_lane = t1 < t_max_lane ? t1 : t_max_lane;
             }
+            enter[i] = t_min;
+            leave[i] = t_max_lane;
+        }
 
-    virtual AABB bounding_box() const override {
-        return bbox;
+        int mask = 0;
+        for (int i = 0; i < N; i++)
+            mask |= int(enter[i] < leave[i]) << i;
+        return mask;
     }
+};
 
-  private:
-    std::shared_ptr<Hittable> left;
-    std::shared_ptr<Hittable> right;
-    AABB bbox;
 
-    static bool box_compare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b, int axis_index) {
-        return a->bounding_box().axis(axis_index).min < b->bounding_box().axis(axis_index).min;
+class BVHNode : public Hittable {
+  public:
+    BVHNode(const HittableList& list, BVHBuildMode mode = BVHBuildMode::serial)
+        : BVHNode(list.objects, 0, list.objects.size(), mode) {}
+
+    BVHNode(const std::vector<std::shared_ptr<Hittable>>& src_objects, size_t start, size_t end,
+            BVHBuildMode mode = BVHBuildMode::serial) {
+        std::vector<AABB> boxes;
+        boxes.reserve(end - start);
+        for (size_t i = start; i < end; i++) {
+            boxes.push_back(src_objects[i]->bounding_box());
+            bbox = AABB(bbox, boxes.back());
+        }
+
+        tree.build(boxes, mode);
+
+        primitives.reserve(end - start);
+        for (uint32_t index : tree.primitive_order) {
+            primitives.push_back(src_objects[start + index]);
+            all_packet_hits = all_packet_hits && primitives.back()->packet_hits();
+        }
+    }
+
+    bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
+        return tree.traverse(r, ray_t, [&](uint32_t index, interval& t) {
+            if (!primitives[index]->hit(r, t, rec))
+                return false;
+            t.max = rec.t;
+            return true;
+        });
+    }
+
+    bool occluded(const RTRay& r, interval ray_t) const override {
+        return tree.occluded(r, ray_t, [&](uint32_t index, const interval& t) {
+            return primitives[index]->occluded(r, t);
+        });
     }
 
-    static bool box_x_compare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b) {
-        return box_compare(a, b, 0);
+    int hit_packet(const RayPacket<packet_width>& rays, int active, interval ray_t,
+                   real t_max[packet_width], HitRecord rec[packet_width]) const override {
+        return tree.traverse_packet(rays, active, ray_t.min, t_max, [&](uint32_t index, int lanes) {
+            return primitives[index]->hit_packet(rays, lanes, ray_t, t_max, rec);
+        });
     }
 
-    static bool box_y_compare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b) {
-        return box_compare(a, b, 1);
+    bool packet_hits() const override {
+        return all_packet_hits;
     }
 
-    static bool box_z_compare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b) {
-        return box_compare(a, b, 2);
+    AABB bounding_box() const override {
+        return bbox;
     }
+
+    const BVHBuildStats& build_stats() const {
+        return tree.stats;
+    }
+
+    // The primitives in build order.
+    const std::vector<std::shared_ptr<Hittable>>& objects() const {
+        return primitives;
+    }
+
+  private:
+    LinearBVH tree;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+    AABB bbox;
+    bool all_packet_hits = true;
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,286 @@
+#ifndef BVH4_H
+#define BVH4_H
+
+
+#include "bvh.h"
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RT_BVH4_SSE 1
+#endif
+
+
+// Four child boxes per node in structure-of-arrays layout, so one ray can be
+// slab-tested against all of them with a single set of 4-wide float operations.
+// A slot with count == 0 points at another BVH4WideNode; a slot with count > 0
+// is a leaf covering primitives [child, child + count). Unused slots are marked
+// with count == BVH4::empty_slot.
+struct alignas(16) BVH4WideNode {
+    float min_x[4], min_y[4], min_z[4];
+    float max_x[4], max_y[4], max_z[4];
+    uint32_t child[4];
+    uint32_t count[4];
+};
+
+
+class BVH4 : public Hittable {
+  public:
+    BVH4(const HittableList& list, BVHBuildMode mode = BVHBuildMode::serial) {
+        auto start_time = std::chrono::steady_clock::now();
+
+        std::vector<AABB> boxes;
+        boxes.reserve(list.objects.size());
+        for (const auto& object : list.objects) {
+            boxes.push_back(object->bounding_box());
+            bbox = AABB(bbox, boxes.back());
+        }
+
+        LinearBVH binary;
+        binary.build(boxes, mode);
+        stats = binary.stats;
+
+        primitives.reserve(list.objects.size());
+        for (uint32_t index : binary.primitive_order)
+            primitives.push_back(list.objects[index]);
+
+        if (!binary.nodes.empty())
+            collapse(binary, 0);
+        stats.node_count = nodes.size();
+
+        // The binary build's time plus collapsing it into wide nodes.
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+        stats.build_ms = elapsed.count();
+    }
+
+    bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
+        return traverse<false>(r, ray_t, [&](uint32_t index, interval& t) {
+            if (!primitives[index]->hit(r, t, rec))
+                return false;
+            t.max = rec.t;
+            return true;
+        });
+    }
+
+    bool occluded(const RTRay& r, interval ray_t) const override {
+        return traverse<true>(r, ray_t, [&](uint32_t index, const interval& t) {
+            return primitives[index]->occluded(r, t);
+        });
+    }
+
+    AABB bounding_box() const override {
+        return bbox;
+    }
+
+    const BVHBuildStats& build_stats() const {
+        return stats;
+    }
+
+    static const uint32_t empty_slot = 0xffffffffu;
+
+  private:
+    std::vector<BVH4WideNode> nodes;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+    BVHBuildStats stats;
+    AABB bbox;
+
+    // Visits the leaves pierced by the ray, nearest box first.
+    // hit_primitive(index, ray_t) tests primitive `index` and must shrink
+    // ray_t.max on a hit; with `any_hit` the first hit ends the traversal.
+    template <bool any_hit, typename HitPrimitive>
+    bool traverse(const RTRay& r, interval ray_t, const HitPrimitive& hit_primitive) const {
+        if (nodes.empty())
+            return false;
+
+        RayLanes ray(r);
+
+        struct Entry {
+            uint32_t child;
+            uint32_t count;
+            float tmin;
+        };
+        Entry stack[256];
+        int stack_size = 0;
+        stack[stack_size++] = {0, 0, float(ray_t.min)};
+
+        bool hit_anything = false;
+
+        while (stack_size > 0) {
+            Entry entry = stack[--stack_size];
+            if (entry.tmin > ray_t.max)
+                continue;
+
+            if (entry.count > 0) {
+                for (uint32_t i = 0; i < entry.count; i++) {
+                    if (hit_primitive(entry.child + i, ray_t)) {
+                        if (any_hit) return true;
+                        hit_anything = true;
+                    }
+                }
+                continue;
+            }
+
+            const BVH4WideNode& node = nodes[entry.child];
+            float tmin[4];
+            int mask = intersect_children(node, ray, float(ray_t.min), float(ray_t.max), tmin);
+
+            // Push hit children farthest first so the nearest one is popped next.
+            int order[4];
+            int hits = 0;
+            for (int i = 0; i < 4; i++) {
+                if (!(mask & (1 << i)) || node.count[i] == empty_slot) continue;
+                int j = hits++;
+                while (j > 0 && tmin[order[j - 1]] < tmin[i]) {
+                    order[j] = order[j - 1];
+                    j--;
+                }
+                order[j] = i;
+            }
+            for (int k = 0; k < hits; k++) {
+                int i = order[k];
+                stack[stack_size++] = {node.child[i], node.count[i], tmin[i]};
+            }
+        }
+
+        return hit_anything;
+    }
+
+    // Per-ray values splatted across the four lanes once, before traversal starts.
+    struct RayLanes {
+        float origin[3];
+        float inv_dir[3];
+
+        RayLanes(const RTRay& r) {
+            for (int a = 0; a < 3; a++) {
+                origin[a] = float(r.origin[a]);
+                inv_dir[a] = float(r.inv_direction[a]);
+            }
+        }
+    };
+
+    // Widens the exit distance by a few ulps so rounding the ray to float never
+    // turns a grazing hit into a miss.
+    static constexpr float exit_scale = 1.0f + 4 * std::numeric_limits<float>::epsilon();
+
+    static int intersect_children(const BVH4WideNode& node, const RayLanes& ray, float ray_tmin, float ray_tmax,
+                                  float tmin_out[4]) {
+#ifdef RT_BVH4_SSE
+        __m128 ox = _mm_set1_ps(ray.origin[0]), oy = _mm_set1_ps(ray.origin[1]), oz = _mm_set1_ps(ray.origin[2]);
+        __m128 ix = _mm_set1_ps(ray.inv_dir[0]), iy = _mm_set1_ps(ray.inv_dir[1]), iz = _mm_set1_ps(ray.inv_dir[2]);
+
+        __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_x), ox), ix);
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_x), ox), ix);
+        __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_y), oy), iy);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_y), oy), iy);
+        __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_z), oz), iz);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_z), oz), iz);
+
+        __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+                                 _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_set1_ps(ray_tmin)));
+        __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+                                 _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(ray_tmax)));
+        tmax = _mm_mul_ps(tmax, _mm_set1_ps(exit_scale));
+
+        _mm_storeu_ps(tmin_out, tmin);
+        return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+#else
+        int mask = 0;
+        for (int i = 0; i < 4; i++) {
+            float t0x = (node.min_x[i] - ray.origin[0]) * ray.inv_dir[0];
+            float t1x = (node.max_x[i] - ray.origin[0]) * ray.inv_dir[0];
+            float t0y = (node.min_y[i] - ray.origin[1]) * ray.inv_dir[1];
+            float t1y = (node.max_y[i] - ray.origin[1]) * ray.inv_dir[1];
+            float t0z = (node.min_z[i] - ray.origin[2]) * ray.inv_dir[2];
+            float t1z = (node.max_z[i] - ray.origin[2]) * ray.inv_dir[2];
+
+            float tmin = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)),
+                                  std::max(std::min(t0z, t1z), ray_tmin));
+            float tmax = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)),
+                                  std::min(std::max(t0z, t1z), ray_tmax));
+
+            tmin_out[i] = tmin;
+            if (tmin <= tmax * exit_scale)
+                mask |= 1 << i;
+        }
+        return mask;
+#endif
+    }
+
+    static float half_area(const BVHLinearNode& node) {
+        float dx = node.bounds_max[0] - node.bounds_min[0];
+        float dy = node.bounds_max[1] - node.bounds_min[1];
+        float dz = node.bounds_max[2] - node.bounds_min[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+
+    // Pulls grandchildren of a binary node up into one wide node, always opening
+    // the interior child with the largest surface area, until four slots are used.
+    uint32_t collapse(const LinearBVH& binary, uint32_t binary_index) {
+        uint32_t index = uint32_t(nodes.size());
+        nodes.emplace_back();
+
+        uint32_t slots[4];
+        int used = 0;
+        const BVHLinearNode& root = binary.nodes[binary_index];
+        if (root.primitive_count > 0) {
+            slots[used++] = binary_index;
+        } else {
+            slots[used++] = binary_index + 1;
+            slots[used++] = root.offset;
+        }
+
+        while (used < 4) {
+            int best = -1;
+            float best_area = -1;
+            for (int i = 0; i < used; i++) {
+                const BVHLinearNode& candidate = binary.nodes[slots[i]];
+                if (candidate.primitive_count == 0 && half_area(candidate) > best_area) {
+                    best = i;
+                    best_area = half_area(candidate);
+                }
+            }
+            if (best < 0) break;
+
+            uint32_t opened = slots[best];
+            slots[best] = opened + 1;
+            slots[used++] = binary.nodes[opened].offset;
+        }
+
+        BVH4WideNode node;
+        for (int i = 0; i < 4; i++) {
+            if (i >= used) {
+                node.min_x[i] = node.min_y[i] = node.min_z[i] = std::numeric_limits<float>::infinity();
+                node.max_x[i] = node.max_y[i] = node.max_z[i] = -std::numeric_limits<float>::infinity();
+                node.child[i] = 0;
+                node.count[i] = empty_slot;
+                continue;
+            }
+
+            const BVHLinearNode& source = binary.nodes[slots[i]];
+            node.min_x[i] = source.bounds_min[0];
+            node.min_y[i] = source.bounds_min[1];
+            node.min_z[i] = source.bounds_min[2];
+            node.max_x[i] = source.bounds_max[0];
+            node.max_y[i] = source.bounds_max[1];
+            node.max_z[i] = source.bounds_max[2];
+
+            if (source.primitive_count > 0) {
+                node.child[i] = source.offset;
+                node.count[i] = source.primitive_count;
+            } else {
+                node.child[i] = collapse(binary, slots[i]);
+                node.count[i] = 0;
+            }
+        }
+
+        nodes[index] = node;
+        return index;
+    }
+};
+
+
+#endif
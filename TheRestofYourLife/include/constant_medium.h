@@ -40,7 +40,8 @@ public:
 
         rec.normal = Vec3(1,0,0);
         rec.front_face = true;    
-        rec.mat = phase_function;
+        rec.mat = phase_function.get();
+        rec.object = nullptr;
 
         return true;
     }
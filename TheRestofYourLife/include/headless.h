@@ -0,0 +1,223 @@
+#ifndef RT_HEADLESS_H
+#define RT_HEADLESS_H
+
+#include "raylib.h"
+
+#include "parallel.h"
+#include "scheduler.h"
+#include "vec3.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Command line settings shared by the interactive viewer and the headless
+// batch renderer. Zero means "use the book's default".
+struct RenderOptions {
+    bool headless = false;
+    std::string scene;
+    int width = 0;
+    int height = 0;
+    int samples_per_pixel = 0;
+    int max_depth = 0;
+    std::string output = "render.png";
+};
+
+inline bool has_extension(const std::string& path, const char* extension) {
+    size_t length = std::strlen(extension);
+    if (path.size() < length) return false;
+    for (size_t k = 0; k < length; ++k) {
+        char c = path[path.size() - length + k];
+        if (c >= 'A' && c <= 'Z') c = char(c - 'A' + 'a');
+        if (c != extension[k]) return false;
+    }
+    return true;
+}
+
+inline void print_render_usage(const char* program) {
+    std::cerr << "usage: " << program << " [--threads N] [--scene NAME] [--width N] [--height N] [--depth N]\n"
+              << "       " << program << " --headless [--spp N] [--out FILE.png|.ppm|.pfm] [options above]\n";
+}
+
+const int max_count = 1 << 20;
+
+// Frame size limits. Pixel indices are ints (j * width + i), so a frame has
+// to stay far below 2^31 pixels; 2^26 is already a 1.5 GB accumulation buffer.
+const int max_dimension = 1 << 14;
+const long long max_pixels = 1LL << 26;
+
+// Parses the value of a numeric flag into `out`. Returns false (after printing
+// an error) unless it is a whole number from `min` to `max`.
+inline bool parse_count(const char* flag, const char* value, int min, int max, int& out) {
+    char* end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < min || parsed > max) {
+        std::cerr << "ERROR: " << flag << " needs a whole number from " << min << " to " << max
+                  << ", got '" << value << "'.\n";
+        return false;
+    }
+    out = int(parsed);
+    return true;
+}
+
+// Fills `options` from argv and applies --threads. Returns false (after
+// printing an error) on an unknown flag, a flag missing its value, a size,
+// sample, depth or thread count that is not positive (widths and heights
+// need two pixels), a frame larger than max_pixels or an output file type
+// write_image() cannot produce.
+inline bool parse_render_options(int argc, char** argv, RenderOptions& options) {
+    for (int a = 1; a < argc; ++a) {
+        const char* arg = argv[a];
+        bool has_value = a + 1 < argc;
+        bool valid = true;
+        int threads = 0;
+
+        if (std::strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strcmp(arg, "--threads") == 0 && has_value) {
+            valid = parse_count(arg, argv[++a], 1, max_count, threads);
+            if (valid)
+                set_render_threads(threads);
+        } else if (std::strcmp(arg, "--scene") == 0 && has_value) {
+            options.scene = argv[++a];
+        } else if (std::strcmp(arg, "--width") == 0 && has_value) {
+            valid = parse_count(arg, argv[++a], 2, max_dimension, options.width);
+        } else if (std::strcmp(arg, "--height") == 0 && has_value) {
+            valid = parse_count(arg, argv[++a], 2, max_dimension, options.height);
+        } else if (std::strcmp(arg, "--spp") == 0 && has_value) {
+            valid = parse_count(arg, argv[++a], 1, max_count, options.samples_per_pixel);
+        } else if (std::strcmp(arg, "--depth") == 0 && has_value) {
+            valid = parse_count(arg, argv[++a], 1, max_count, options.max_depth);
+        } else if (std::strcmp(arg, "--out") == 0 && has_value) {
+            options.output = argv[++a];
+        } else {
+            std::cerr << "ERROR: Unknown or incomplete option '" << arg << "'.\n";
+            print_render_usage(argv[0]);
+            return false;
+        }
+
+        if (!valid) {
+            print_render_usage(argv[0]);
+            return false;
+        }
+    }
+
+    if ((long long)options.width * options.height > max_pixels) {
+        std::cerr << "ERROR: A " << options.width << 'x' << options.height << " frame is larger than "
+                  << max_pixels << " pixels.\n";
+        return false;
+    }
+
+    if (options.headless && !has_extension(options.output, ".png") &&
+        !has_extension(options.output, ".ppm") && !has_extension(options.output, ".pfm")) {
+        std::cerr << "ERROR: Unsupported output format '" << options.output << "' (use .png, .ppm or .pfm).\n";
+        return false;
+    }
+    return true;
+}
+
+// Renders a full frame on the CPU and returns the accumulation buffer (the sum
+// of `samples_per_pixel` samples per pixel). `sample(i, j)` traces one sample
+// for pixel (i, j); the per-pixel RNG stream is seeded before the first one,
+// so output is reproducible for any thread count.
+template <typename Sample>
+std::vector<Color3> render_headless(int width, int height, int samples_per_pixel, const Sample& sample) {
+    std::vector<Color3> buffer(width * height, Color3(0, 0, 0));
+    TileScheduler scheduler(width, height);
+
+    auto start = std::chrono::steady_clock::now();
+    scheduler.run([&](const Tile& tile) {
+        for (int j = tile.y0; j < tile.y1; ++j) {
+            for (int i = tile.x0; i < tile.x1; ++i) {
+                int pixel_index = j * width + i;
+                seed_thread_rng(0, pixel_index);
+                Color3 pixel_color(0, 0, 0);
+                for (int s = 0; s < samples_per_pixel; ++s)
+                    pixel_color += sample(i, j);
+                buffer[pixel_index] = pixel_color;
+            }
+        }
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::clog << "Rendered " << width << 'x' << height << " at " << samples_per_pixel << " spp on "
+              << render_threads() << " threads in " << seconds << " s\n";
+    return buffer;
+}
+
+// Averages an accumulation buffer, dropping NaN channels.
+inline Color3 resolve_pixel(const Color3& sum, int samples) {
+    Color3 col = sum / double(samples);
+    if (col.x != col.x) col.x = 0;
+    if (col.y != col.y) col.y = 0;
+    if (col.z != col.z) col.z = 0;
+    return col;
+}
+
+inline unsigned char gamma_byte(double linear) {
+    double value = std::sqrt(std::fmax(linear, 0.0));
+    return (unsigned char)(256 * std::fmin(value, 0.999));
+}
+
+// Writes the accumulation buffer (sum of `samples` passes) as an 8-bit
+// gamma-2 PPM or PNG, or as a linear float PFM, chosen by file extension.
+// PNG goes through raylib's ExportImage, which needs no window.
+inline bool write_image(const std::string& path, const std::vector<Color3>& buffer,
+                        int width, int height, int samples) {
+    if (has_extension(path, ".pfm")) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "ERROR: Could not open '" << path << "' for writing.\n";
+            return false;
+        }
+        out << "PF\n" << width << ' ' << height << "\n-1.0\n";
+        // PFM rows run bottom to top, little-endian floats.
+        for (int j = height - 1; j >= 0; --j) {
+            for (int i = 0; i < width; ++i) {
+                Color3 col = resolve_pixel(buffer[j * width + i], samples);
+                float rgb[3] = { float(col.x), float(col.y), float(col.z) };
+                out.write(reinterpret_cast<const char*>(rgb), sizeof(rgb));
+            }
+        }
+        return bool(out);
+    }
+
+    if (has_extension(path, ".ppm")) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "ERROR: Could not open '" << path << "' for writing.\n";
+            return false;
+        }
+        out << "P6\n" << width << ' ' << height << "\n255\n";
+        for (int p = 0; p < width * height; ++p) {
+            Color3 col = resolve_pixel(buffer[p], samples);
+            unsigned char rgb[3] = { gamma_byte(col.x), gamma_byte(col.y), gamma_byte(col.z) };
+            out.write(reinterpret_cast<const char*>(rgb), sizeof(rgb));
+        }
+        return bool(out);
+    }
+
+    if (has_extension(path, ".png")) {
+        Image image = GenImageColor(width, height, BLACK);
+        Color* pixels = (Color*)image.data;
+        for (int p = 0; p < width * height; ++p) {
+            Color3 col = resolve_pixel(buffer[p], samples);
+            pixels[p] = Color{ gamma_byte(col.x), gamma_byte(col.y), gamma_byte(col.z), 255 };
+        }
+        bool ok = ExportImage(image, path.c_str());
+        UnloadImage(image);
+        if (!ok)
+            std::cerr << "ERROR: Could not write '" << path << "'.\n";
+        return ok;
+    }
+
+    std::cerr << "ERROR: Unsupported output format '" << path << "' (use .png, .ppm or .pfm).\n";
+    return false;
+}
+
+#endif
@@ -5,23 +5,39 @@
 #include "aabb.h"     
 #include "ray.h"
 #include "interval.h"  
+#include "onb.h"
+#include "simd.h"
 
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <vector>
 
 class RTMaterial;
+class Hittable;
 
+// hit() only has to fill in t. A shape may leave the rest of the surface
+// (p, normal, front_face, u, v and mat) for later by pointing `object` at
+// itself, keeping whatever it needs to find the spot again in `primitive`
+// and u/v; finish_hit() fills the surface in once the closest hit is known,
+// so candidates that a closer hit replaces never pay for it.
 struct HitRecord {
     Point3 p;
     Vec3 normal;
-    std::shared_ptr<RTMaterial> mat;
-    double t;
-    double u; 
-    double v;
+    const RTMaterial* mat;
+    real t;
+    real u; 
+    real v;
     bool front_face;
+    const Hittable* object = nullptr;
+    uint32_t primitive;
 
     void set_face_normal(const RTRay& r, const Vec3& outward_normal) {
-        front_face = dot(r.direction, outward_normal) < 0;
+        set_face_normal(r.direction, outward_normal);
+    }
+
+    void set_face_normal(const Vec3& direction, const Vec3& outward_normal) {
+        front_face = dot(direction, outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
     }
 };
@@ -34,6 +50,38 @@ public:
 
     virtual AABB bounding_box() const = 0;
 
+    // Fills in the surface of a hit this shape left unfinished in hit().
+    virtual void set_surface(const RTRay&, HitRecord&) const {}
+
+    // True if the ray hits anything in ray_t. Shadow rays only need this, so
+    // shapes override it with a test that may stop at the first hit found
+    // and never works out the normal, UV or material that hit() fills in.
+    virtual bool occluded(const RTRay& r, interval ray_t) const {
+        HitRecord rec;
+        return hit(r, ray_t, rec);
+    }
+
+    // Intersects the lanes of a packet selected by `active` (bit i for lane
+    // i), each against [ray_t.min, t_max[i]] as hit() would. On a hit rec[i]
+    // records it as hit() does, t_max[i] is lowered to the hit and bit i of
+    // the result set.
+    // The default runs hit() one lane at a time; shapes with a lane-parallel
+    // test override it.
+    virtual int hit_packet(const RayPacket<packet_width>& rays, int active, interval ray_t,
+                           real t_max[packet_width], HitRecord rec[packet_width]) const {
+        int mask = 0;
+        RTRay built;
+        for (int i = 0; i < packet_width; i++) {
+            if (!((active >> i) & 1)) continue;
+            const RTRay& r = rays.source ? rays.source[i] : (built = rays.ray(i));
+            if (hit(r, interval(ray_t.min, t_max[i]), rec[i])) {
+                t_max[i] = rec[i].t;
+                mask |= 1 << i;
+            }
+        }
+        return mask;
+    }
+
     virtual double pdf_value(const Point3& origin, const Vec3& v) const {
         return 0.0;
     }
@@ -41,8 +89,20 @@ public:
     virtual Vec3 random(const Point3& origin) const {
         return Vec3(1, 0, 0);
     }
+
+    // True if hit_packet() tests the lanes together all the way down, i.e. no
+    // shape underneath falls back to the one-lane-at-a-time default.
+    virtual bool packet_hits() const { return false; }
 };
 
+// Completes a record returned by hit() for ray `r`, the ray hit() was given.
+inline void finish_hit(const RTRay& r, HitRecord& rec) {
+    if (const Hittable* object = rec.object) {
+        rec.object = nullptr;
+        object->set_surface(r, rec);
+    }
+}
+
 class Sphere : public Hittable {
 public:
     Sphere(Point3 center, double radius, std::shared_ptr<RTMaterial> mat)
@@ -60,40 +120,123 @@ public:
     }
 
     bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
-        Point3 center = is_moving ? sphere_center(r.tm) : center1;
-        
-        Vec3 oc = r.origin - center;
-        auto a = r.direction.length_squared();
-        auto half_b = dot(oc, r.direction);
-        auto c = oc.length_squared() - radius * radius;
-
-        auto discriminant = half_b * half_b - a * c;
-        if (discriminant < 0) return false;
-        auto sqrtd = sqrt(discriminant);
-
-        auto root = (-half_b - sqrtd) / a;
-        if (!ray_t.surrounds(root)) {
-            root = (-half_b + sqrtd) / a;
-            if (!ray_t.surrounds(root))
-                return false;
-        }
+        real root;
+        if (!nearest_root(r, is_moving ? sphere_center(r.tm) : center1, ray_t, root))
+            return false;
 
         rec.t = root;
+        rec.object = this;
+        return true;
+    }
+
+    void set_surface(const RTRay& r, HitRecord& rec) const override {
+        Point3 center = is_moving ? sphere_center(r.tm) : center1;
         rec.p = r.at(rec.t);
         Vec3 outward_normal = (rec.p - center) / radius;
         rec.set_face_normal(r, outward_normal);
 
         get_sphere_uv(outward_normal, rec.u, rec.v);
 
-        rec.mat = mat;
+        rec.mat = mat.get();
+    }
 
-        return true;
+    bool occluded(const RTRay& r, interval ray_t) const override {
+        real root;
+        return nearest_root(r, is_moving ? sphere_center(r.tm) : center1, ray_t, root);
+    }
+
+    int hit_packet(const RayPacket<packet_width>& rays, int active, interval ray_t,
+                   real t_max[packet_width], HitRecord rec[packet_width]) const override {
+        return hit_packet<packet_width>(rays, active, ray_t, t_max, rec);
+    }
+
+    bool packet_hits() const override { return true; }
+
+    // Tests a packet of rays at once. Active lane i hits if the sphere is
+    // crossed in (ray_t.min, t_max[i]); then rec[i] records the hit, t_max[i]
+    // lowered to the hit and bit i of the returned mask set. Other lanes are
+    // left untouched.
+    template <int N>
+    int hit_packet(const RayPacket<N>& rays, int active, const interval& ray_t, real t_max[N], HitRecord rec[N]) const {
+        Vec3xN<N> center;
+        for (int i = 0; i < N; i++) {
+            real time = is_moving ? rays.tm[i] : 0;
+            center.x[i] = center1.x + time * (center2.x - center1.x);
+            center.y[i] = center1.y + time * (center2.y - center1.y);
+            center.z[i] = center1.z + time * (center2.z - center1.z);
+        }
+
+        // Missed lanes get a NaN root, which fails every comparison, rather
+        // than a bool flag: keeping every array as wide as `real` is what lets
+        // the loop vectorize.
+        real root[N];
+        RT_LANE_LOOP
+        for (int i = 0; i < N; i++) {
+            real ocx = rays.origin.x[i] - center.x[i];
+            real ocy = rays.origin.y[i] - center.y[i];
+            real ocz = rays.origin.z[i] - center.z[i];
+            real dx = rays.direction.x[i], dy = rays.direction.y[i], dz = rays.direction.z[i];
+
+            real a = dx * dx + dy * dy + dz * dz;
+            real half_b = ocx * dx + ocy * dy + ocz * dz;
+            real c = ocx * ocx + ocy * ocy + ocz * ocz - real(radius * radius);
+            real discriminant = half_b * half_b - a * c;
+            real sqrtd = std::sqrt(discriminant < 0 ? real(0) : discriminant);
+
+            real near_root = (-half_b - sqrtd) / a;
+            real far_root = (-half_b + sqrtd) / a;
+            // & and | rather than && and ||, so there are no branches.
+            bool near_hit = (ray_t.min < near_root) & (near_root < t_max[i]);
+            bool far_hit = (ray_t.min < far_root) & (far_root < t_max[i]);
+            bool hit = (discriminant >= 0) & (near_hit | far_hit);
+
+            real nearest = near_hit ? near_root : far_root;
+            root[i] = hit ? nearest : std::numeric_limits<real>::quiet_NaN();
+        }
+
+        int mask = 0;
+        for (int i = 0; i < N; i++) {
+            if (!((active >> i) & 1) || !(root[i] < t_max[i])) continue;
+            rec[i].t = root[i];
+            rec[i].object = this;
+            t_max[i] = root[i];
+            mask |= 1 << i;
+        }
+        return mask;
     }
 
     AABB bounding_box() const override {
         return bbox;
     }
 
+    // Light sampling treats the sphere as stationary at center1. From outside
+    // it samples the cone the sphere subtends, which is 1 / solid angle; from
+    // inside every direction hits it, so it falls back to the whole sphere.
+    double pdf_value(const Point3& origin, const Vec3& v) const override {
+        HitRecord rec;
+        if (!hit(RTRay(origin, v), interval(0.001, infinity), rec))
+            return 0;
+
+        auto distance_squared = (center1 - origin).length_squared();
+        if (distance_squared <= radius * radius)
+            return 1 / (4 * pi);
+
+        auto cos_theta_max = std::sqrt(1 - radius * radius / distance_squared);
+        auto solid_angle = 2 * pi * (1 - cos_theta_max);
+        return 1 / solid_angle;
+    }
+
+    Vec3 random(const Point3& origin) const override {
+        Vec3 direction = center1 - origin;
+        auto distance_squared = direction.length_squared();
+        if (distance_squared <= radius * radius)
+            return random_unit_vector();
+
+        Onb uvw;
+        uvw.build_from_w(direction);
+        return uvw.local(random_to_sphere(radius, distance_squared));
+    }
+
 private:
     Point3 center1;
     Point3 center2;
@@ -105,8 +248,28 @@ private:
     Point3 sphere_center(double time) const {
         return center1 + time * (center2 - center1);
     }
-    
-    static void get_sphere_uv(const Point3& p, double& u, double& v) {
+
+    // The nearest t in ray_t where `r` crosses the sphere around `center`.
+    bool nearest_root(const RTRay& r, const Point3& center, const interval& ray_t, real& root) const {
+        Vec3 oc = r.origin - center;
+        auto a = r.direction.length_squared();
+        auto half_b = dot(oc, r.direction);
+        auto c = oc.length_squared() - radius * radius;
+
+        auto discriminant = half_b * half_b - a * c;
+        if (discriminant < 0) return false;
+        auto sqrtd = sqrt(discriminant);
+
+        root = (-half_b - sqrtd) / a;
+        if (!ray_t.surrounds(root)) {
+            root = (-half_b + sqrtd) / a;
+            if (!ray_t.surrounds(root))
+                return false;
+        }
+        return true;
+    }
+
+    static void get_sphere_uv(const Point3& p, real& u, real& v) {
         auto theta = acos(-p.y);
         auto phi = atan2(-p.z, p.x) + pi;
 
@@ -122,29 +285,50 @@ public:
     HittableList() {}
     HittableList(std::shared_ptr<Hittable> object) { add(object); }
 
-    void clear() { objects.clear(); }
+    void clear() {
+        objects.clear();
+        all_packet_hits = true;
+    }
 
     void add(std::shared_ptr<Hittable> object) {
         objects.push_back(object);
         bbox = AABB(bbox, object->bounding_box());
+        all_packet_hits = all_packet_hits && object->packet_hits();
     }
 
     bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
-        HitRecord temp_rec;
         bool hit_anything = false;
         auto closest_so_far = ray_t.max;
 
         for (const auto& object : objects) {
-            if (object->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+            if (object->hit(r, interval(ray_t.min, closest_so_far), rec)) {
                 hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
+                closest_so_far = rec.t;
             }
         }
 
         return hit_anything;
     }
 
+    bool occluded(const RTRay& r, interval ray_t) const override {
+        for (const auto& object : objects)
+            if (object->occluded(r, ray_t))
+                return true;
+        return false;
+    }
+
+    int hit_packet(const RayPacket<packet_width>& rays, int active, interval ray_t,
+                   real t_max[packet_width], HitRecord rec[packet_width]) const override {
+        int mask = 0;
+        for (const auto& object : objects)
+            mask |= object->hit_packet(rays, active, ray_t, t_max, rec);
+        return mask;
+    }
+
+    bool packet_hits() const override {
+        return all_packet_hits;
+    }
+
     AABB bounding_box() const override {
         return bbox;
     }
@@ -166,6 +350,7 @@ public:
 
 private:
     AABB bbox;
+    bool all_packet_hits = true;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,212 @@
+#ifndef RT_INTEGRATOR_H
+#define RT_INTEGRATOR_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "material.h"
+#include "scheduler.h"
+#include "simd.h"
+#include "pdf.h"
+
+#include <cmath>
+
+// Paths stop being forced to continue after this many bounces; from then on
+// each bounce survives with probability equal to the brightest throughput
+// channel and the survivors are reweighted, so the estimate stays unbiased.
+const int roulette_min_bounces = 3;
+
+inline bool russian_roulette(Color3& throughput) {
+    double survive = std::fmin(std::fmax(throughput.x, std::fmax(throughput.y, throughput.z)), 0.95);
+    if (random_double() >= survive)
+        return false;
+    throughput = throughput / survive;
+    return true;
+}
+
+// Multiple importance sampling weight of a sample drawn with density
+// `pdf_f` that could also have come from a strategy with density `pdf_g`.
+inline double power_heuristic(double pdf_f, double pdf_g) {
+    double f2 = pdf_f * pdf_f;
+    double g2 = pdf_g * pdf_g;
+    return f2 + g2 > 0 ? f2 / (f2 + g2) : 0;
+}
+
+// Next-event estimation at a diffuse vertex: samples a direction towards
+// `lights`, traces a shadow ray and returns the light's contribution
+// weighted against the chance that sampling the material would have found
+// the same light. The caller scales it by the path throughput.
+inline Color3 sample_lights(const RTRay& ray, const HitRecord& rec, const ScatterRecord& srec,
+                            const Hittable& world, const Hittable& lights) {
+    RTRay shadow(rec.p, unit_vector(lights.random(rec.p)), ray.tm);
+
+    HitRecord light_rec;
+    if (!lights.hit(shadow, interval(0.001, infinity), light_rec))
+        return Color3(0,0,0);
+    finish_hit(shadow, light_rec);
+
+    double light_pdf = lights.pdf_value(rec.p, shadow.direction);
+    double scattering_pdf = rec.mat->scattering_pdf(ray, rec, shadow);
+    if (light_pdf <= 0 || scattering_pdf <= 0)
+        return Color3(0,0,0);
+
+    Color3 emitted = light_rec.mat->emitted(shadow, light_rec, light_rec.u, light_rec.v, light_rec.p);
+    if (emitted.x == 0 && emitted.y == 0 && emitted.z == 0)
+        return Color3(0,0,0);
+
+    // Anything in front of the light blocks it. The light list holds its own
+    // copies of the lights, so the light itself is left out of the range.
+    if (world.occluded(shadow, interval(0.001, light_rec.t - 0.001)))
+        return Color3(0,0,0);
+
+    double weight = power_heuristic(light_pdf, srec.pdf.value(shadow.direction));
+    return srec.attenuation * emitted * (scattering_pdf * weight / light_pdf);
+}
+
+// Continues the path of camera ray `r` whose first intersection is already
+// known (from trace_camera_packet): `first_hit` says whether `r` hit
+// anything and `first` is the record if it did.
+//
+// Direct light is gathered two ways at every diffuse vertex: a light sample
+// with a shadow ray (sample_lights) and the material's own sample, which
+// picks up emission if it happens to hit a light. Each is weighted with the
+// power heuristic, so neither strategy's noise dominates. Emission seen
+// straight from the camera or through a mirror or glass can only come from
+// the second strategy and keeps its full weight.
+inline Color3 ray_color(const RTRay& r, bool first_hit, const HitRecord& first, int depth,
+                        const Hittable& world, const Hittable& lights) {
+    Color3 radiance(0,0,0);
+    Color3 throughput(1,1,1);
+    RTRay ray = r;
+    HitRecord rec = first;
+
+    // Density the last bounce was sampled with, 0 if a light sample could
+    // not have produced it (the camera ray or a specular bounce).
+    double scatter_pdf = 0;
+
+    for (int bounce = 0; bounce < depth; bounce++) {
+        bool hit = bounce == 0 ? first_hit : world.hit(ray, interval(0.001, infinity), rec);
+        if (!hit)
+            break;
+        finish_hit(ray, rec);
+
+        ScatterRecord srec;
+
+        Color3 emitted = rec.mat->emitted(ray, rec, rec.u, rec.v, rec.p);
+        if (scatter_pdf > 0 && (emitted.x != 0 || emitted.y != 0 || emitted.z != 0))
+            emitted = emitted * power_heuristic(scatter_pdf, lights.pdf_value(ray.origin, ray.direction));
+        radiance += throughput * emitted;
+
+        if (!rec.mat->scatter(ray, rec, srec))
+            break;
+
+        if (srec.skip_pdf) {
+            throughput = throughput * srec.attenuation;
+            ray = srec.skip_pdf_ray;
+            scatter_pdf = 0;
+        } else {
+            // The light sample stands in for the emission at the next
+            // vertex, so there is none on the last bounce.
+            if (bounce + 1 < depth)
+                radiance += throughput * sample_lights(ray, rec, srec, world, lights);
+
+            RTRay scattered = RTRay(rec.p, srec.pdf.generate(), ray.tm);
+            scatter_pdf = srec.pdf.value(scattered.direction);
+
+            double scattering_pdf = rec.mat->scattering_pdf(ray, rec, scattered);
+
+            if (scatter_pdf == 0) break;
+
+            throughput = throughput * srec.attenuation * scattering_pdf / scatter_pdf;
+            ray = scattered;
+        }
+
+        if (bounce + 1 >= roulette_min_bounces && !russian_roulette(throughput))
+            break;
+    }
+
+    return radiance;
+}
+
+inline Color3 ray_color(const RTRay& r, int depth, const Hittable& world, const Hittable& lights) {
+    HitRecord rec{};
+    bool hit = depth > 0 && world.hit(r, interval(0.001, infinity), rec);
+    return ray_color(r, hit, rec, depth, world, lights);
+}
+
+// A 2x2 block of pixels traced as one packet: lane k is pixel
+// (x + (k & 1), y + (k >> 1)), and lanes that fall outside the tile are left
+// out of `active`.
+struct PixelBlock {
+    int x, y;
+    int active;
+
+    int i(int lane) const { return x + (lane & 1); }
+    int j(int lane) const { return y + (lane >> 1); }
+};
+
+template <typename Body>
+inline void for_each_pixel_block(const Tile& tile, const Body& body) {
+    for (int y = tile.y0; y < tile.y1; y += 2) {
+        for (int x = tile.x0; x < tile.x1; x += 2) {
+            PixelBlock block{x, y, 0};
+            for (int lane = 0; lane < packet_width; lane++)
+                if (block.i(lane) < tile.x1 && block.j(lane) < tile.y1)
+                    block.active |= 1 << lane;
+            body(block);
+        }
+    }
+}
+
+// Traces the camera rays of a pixel block as one packet to their first hit
+// (if every shape in `world` has a packet test), then finishes each path on
+// its own: after the first bounce the rays scatter in all directions and a
+// packet would mostly hold idle lanes.
+// make_ray(lane) samples lane's camera ray. rng[lane] is the lane's sampler;
+// it is swapped in around make_ray and the rest of that lane's path, so
+// every pixel gets exactly the result it would get traced alone.
+template <typename MakeRay>
+inline void trace_camera_packet(int active, Pcg32 rng[packet_width], const MakeRay& make_ray,
+                                int depth, const Hittable& world, const Hittable& lights, Color3 color[packet_width]) {
+    RTRay rays[packet_width];
+    RayPacket<packet_width> packet;
+    int lead = -1;
+    for (int lane = 0; lane < packet_width; lane++) {
+        if (!((active >> lane) & 1)) continue;
+        thread_rng() = rng[lane];
+        rays[lane] = make_ray(lane);
+        rng[lane] = thread_rng();
+        if (lead < 0) lead = lane;
+    }
+    if (lead < 0) return;
+
+    // A world with shapes that lack a packet test would test them one lane
+    // at a time anyway, at a higher cost than tracing each ray on its own.
+    if (!world.packet_hits()) {
+        for (int lane = 0; lane < packet_width; lane++) {
+            if (!((active >> lane) & 1)) continue;
+            thread_rng() = rng[lane];
+            color[lane] = ray_color(rays[lane], depth, world, lights);
+            rng[lane] = thread_rng();
+        }
+        return;
+    }
+
+    // Idle lanes repeat a live ray so every lane holds finite numbers.
+    for (int lane = 0; lane < packet_width; lane++)
+        packet.set(lane, rays[(active >> lane) & 1 ? lane : lead]);
+    packet.source = rays;
+
+    real t_max[packet_width];
+    HitRecord rec[packet_width]{};
+    for (real& t : t_max) t = infinity;
+    int hits = depth > 0 ? world.hit_packet(packet, active, interval(0.001, infinity), t_max, rec) : 0;
+
+    for (int lane = 0; lane < packet_width; lane++) {
+        if (!((active >> lane) & 1)) continue;
+        thread_rng() = rng[lane];
+        color[lane] = ray_color(rays[lane], (hits >> lane) & 1, rec[lane], depth, world, lights);
+        rng[lane] = thread_rng();
+    }
+}
+
+#endif
@@ -1,42 +1,44 @@
 #ifndef INTERVAL_H
 #define INTERVAL_H
 
-#include <limits> 
+#include "real.h"
+
+#include <limits>
 
 class interval {
   public:
-    double min, max;
+    real min, max;
 
     interval() 
-        : min(+std::numeric_limits<double>::infinity()), 
-          max(-std::numeric_limits<double>::infinity()) {} 
+        : min(+std::numeric_limits<real>::infinity()), 
+          max(-std::numeric_limits<real>::infinity()) {} 
 
-    interval(double min, double max) : min(min), max(max) {}
+    interval(real min, real max) : min(min), max(max) {}
 
     interval(const interval& a, const interval& b) {
         min = a.min <= b.min ? a.min : b.min;
         max = a.max >= b.max ? a.max : b.max;
     }
 
-    double size() const {
+    real size() const {
         return max - min;
     }
 
-    bool contains(double x) const {
+    bool contains(real x) const {
         return min <= x && x <= max;
     }
 
-    bool surrounds(double x) const {
+    bool surrounds(real x) const {
         return min < x && x < max;
     }
 
-    double clamp(double x) const {
+    real clamp(real x) const {
         if (x < min) return min;
         if (x > max) return max;
         return x;
     }
 
-    interval expand(double delta) const {
+    interval expand(real delta) const {
         auto padding = delta/2;
         return interval(min - padding, max + padding);
     }
@@ -44,14 +46,14 @@ class interval {
     static const interval empty, universe;
 };
 
-inline const interval interval::empty    = interval(+std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity());
-inline const interval interval::universe = interval(-std::numeric_limits<double>::infinity(), +std::numeric_limits<double>::infinity());
+inline const interval interval::empty    = interval(+std::numeric_limits<real>::infinity(), -std::numeric_limits<real>::infinity());
+inline const interval interval::universe = interval(-std::numeric_limits<real>::infinity(), +std::numeric_limits<real>::infinity());
 
-inline interval operator+(const interval& ival, double displacement) {
+inline interval operator+(const interval& ival, real displacement) {
         return interval(ival.min + displacement, ival.max + displacement);
 }
 
-inline interval operator+(double displacement, const interval& ival) {
+inline interval operator+(real displacement, const interval& ival) {
         return ival + displacement;
 }
 
@@ -5,12 +5,11 @@
 #include "texture.h" 
 
 #include "hittable.h"
-
-class Pdf; 
+#include "pdf.h"
 
 struct ScatterRecord {
     Color3 attenuation;
-    std::shared_ptr<Pdf> pdf_ptr;
+    ScatterPdf pdf;
     bool skip_pdf;      
     RTRay skip_pdf_ray; 
 };
@@ -84,4 +83,16 @@ private:
     std::shared_ptr<RTTexture> tex;
 };
 
+class Isotropic : public RTMaterial {
+public:
+    Isotropic(const Color3& albedo) : tex(std::make_shared<SolidColor>(albedo)) {}
+    Isotropic(std::shared_ptr<RTTexture> tex) : tex(tex) {}
+
+    bool scatter(const RTRay& r_in, const HitRecord& rec, ScatterRecord& srec) const override;
+    double scattering_pdf(const RTRay& r_in, const HitRecord& rec, const RTRay& scattered) const override;
+
+private:
+    std::shared_ptr<RTTexture> tex;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,257 @@
+#ifndef RT_MESH_H
+#define RT_MESH_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "bvh.h"
+#include "vec3.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct MeshTexcoord {
+    double u, v;
+};
+
+// Vertex and index buffers for a triangle mesh. Every vertex has a position;
+// normals and texcoords are either empty or one per vertex. `indices` holds
+// three vertex indices per triangle. Meshes are shared between TriangleMesh
+// instances through a shared_ptr<const MeshData>.
+struct MeshData {
+    std::vector<Point3> positions;
+    std::vector<Vec3> normals;
+    std::vector<MeshTexcoord> texcoords;
+    std::vector<uint32_t> indices;
+
+    size_t triangle_count() const { return indices.size() / 3; }
+
+    AABB bounds() const {
+        AABB box;
+        for (const Point3& p : positions)
+            box = AABB(box, AABB(p, p));
+        return box;
+    }
+
+    // Uniformly scales and moves the mesh so it fits inside `target`, centred
+    // in x and z and resting on its floor.
+    void fit_to(const AABB& target) {
+        AABB box = bounds();
+        double scale = std::fmin(target.x.size() / box.x.size(),
+                       std::fmin(target.y.size() / box.y.size(), target.z.size() / box.z.size()));
+        Point3 from(0.5 * (box.x.min + box.x.max), box.y.min, 0.5 * (box.z.min + box.z.max));
+        Point3 to(0.5 * (target.x.min + target.x.max), target.y.min, 0.5 * (target.z.min + target.z.max));
+        for (Point3& p : positions)
+            p = to + scale * (p - from);
+    }
+};
+
+// Flat, read-only view of a mesh and its BVH. The arrays live either in a
+// MeshData + LinearBVH owned by the TriangleMesh or in a mapped cache file
+// (mesh_cache.h); `normals` and `texcoords` are null when absent.
+struct MeshView {
+    const Point3* positions = nullptr;
+    const Vec3* normals = nullptr;
+    const MeshTexcoord* texcoords = nullptr;
+    const uint32_t* indices = nullptr;
+    size_t vertex_count = 0;
+    size_t triangle_count = 0;
+    const BVHLinearNode* nodes = nullptr;
+    size_t node_count = 0;
+    const uint32_t* primitive_order = nullptr;
+};
+
+// A triangle mesh intersected through its own BVH over the triangles, so a
+// mesh is a single Hittable regardless of its triangle count.
+class TriangleMesh : public Hittable {
+  public:
+    TriangleMesh(std::shared_ptr<const MeshData> data, std::shared_ptr<RTMaterial> mat,
+                 BVHBuildMode mode = BVHBuildMode::serial)
+        : storage(data), mat(mat) {
+        const MeshData& mesh = *data;
+        std::vector<AABB> boxes;
+        boxes.reserve(mesh.triangle_count());
+        for (size_t tri = 0; tri < mesh.triangle_count(); tri++) {
+            const Point3& p0 = mesh.positions[mesh.indices[3 * tri + 0]];
+            const Point3& p1 = mesh.positions[mesh.indices[3 * tri + 1]];
+            const Point3& p2 = mesh.positions[mesh.indices[3 * tri + 2]];
+            boxes.push_back(AABB(AABB(p0, p1), AABB(p2, p2)));
+            bbox = AABB(bbox, boxes.back());
+        }
+        tree.build(boxes, mode);
+        stats = tree.stats;
+
+        view.positions = mesh.positions.data();
+        view.normals = mesh.normals.empty() ? nullptr : mesh.normals.data();
+        view.texcoords = mesh.texcoords.empty() ? nullptr : mesh.texcoords.data();
+        view.indices = mesh.indices.data();
+        view.vertex_count = mesh.positions.size();
+        view.triangle_count = mesh.triangle_count();
+        view.nodes = tree.nodes.data();
+        view.node_count = tree.nodes.size();
+        view.primitive_order = tree.primitive_order.data();
+    }
+
+    // Uses arrays that already hold a built BVH (e.g. a mapped cache file).
+    // `owner` keeps them alive for the lifetime of the mesh.
+    TriangleMesh(const MeshView& view, std::shared_ptr<const void> owner, std::shared_ptr<RTMaterial> mat)
+        : storage(std::move(owner)), mat(mat), view(view) {
+        const BVHLinearNode& root = view.nodes[0];
+        bbox = AABB(Point3(root.bounds_min[0], root.bounds_min[1], root.bounds_min[2]),
+                    Point3(root.bounds_max[0], root.bounds_max[1], root.bounds_max[2]));
+        stats.primitive_count = view.triangle_count;
+        stats.node_count = view.node_count;
+        for (size_t k = 0; k < view.node_count; k++)
+            stats.leaf_count += view.nodes[k].primitive_count > 0;
+    }
+
+    // `view` points into this object's own buffers.
+    TriangleMesh(const TriangleMesh&) = delete;
+    TriangleMesh& operator=(const TriangleMesh&) = delete;
+
+    bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
+        WatertightRay wr(r);
+        uint32_t closest_triangle = 0;
+        double closest_t = 0, b1 = 0, b2 = 0;
+
+        bool hit_anything = LinearBVH::traverse_nodes(view.nodes, view.node_count, r, ray_t,
+                                                      [&](uint32_t index, interval& t) {
+            uint32_t tri = view.primitive_order[index];
+            double hit_t, u, v;
+            if (!intersect_triangle(wr, tri, t, hit_t, u, v))
+                return false;
+            t.max = closest_t = hit_t;
+            closest_triangle = tri;
+            b1 = u;
+            b2 = v;
+            return true;
+        });
+        if (!hit_anything)
+            return false;
+
+        // Normals, UVs and the hit point are only worked out by
+        // set_surface(), for the closest hit in the whole scene.
+        rec.t = closest_t;
+        rec.primitive = closest_triangle;
+        rec.u = b1;
+        rec.v = b2;
+        rec.object = this;
+        return true;
+    }
+
+    void set_surface(const RTRay& r, HitRecord& rec) const override {
+        fill_record(r, rec.t, rec.primitive, rec.u, rec.v, rec);
+    }
+
+    bool occluded(const RTRay& r, interval ray_t) const override {
+        WatertightRay wr(r);
+        return LinearBVH::traverse_nodes<true>(view.nodes, view.node_count, r, ray_t,
+                                               [&](uint32_t index, const interval& t) {
+            double hit_t, u, v;
+            return intersect_triangle(wr, view.primitive_order[index], t, hit_t, u, v);
+        });
+    }
+
+    AABB bounding_box() const override { return bbox; }
+
+    const BVHBuildStats& build_stats() const { return stats; }
+
+    const MeshView& mesh_view() const { return view; }
+
+  private:
+    // Per-ray setup for the watertight test of Woop, Benthin and Wald (2013):
+    // the ray is sheared so it points down +z, which makes the edge tests
+    // exact for shared edges and vertices (no cracks between triangles).
+    struct WatertightRay {
+        Point3 origin;
+        int kx, ky, kz;
+        double sx, sy, sz;
+
+        explicit WatertightRay(const RTRay& r) : origin(r.origin) {
+            Vec3 d = r.direction;
+            double ax = std::fabs(d.x), ay = std::fabs(d.y), az = std::fabs(d.z);
+            kz = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+            kx = (kz + 1) % 3;
+            ky = (kx + 1) % 3;
+            if (d[kz] < 0) std::swap(kx, ky);
+            sx = d[kx] / d[kz];
+            sy = d[ky] / d[kz];
+            sz = 1.0 / d[kz];
+        }
+    };
+
+    bool intersect_triangle(const WatertightRay& wr, uint32_t tri, const interval& ray_t,
+                            double& t, double& b1, double& b2) const {
+        const MeshView& mesh = view;
+        Vec3 a = mesh.positions[mesh.indices[3 * tri + 0]] - wr.origin;
+        Vec3 b = mesh.positions[mesh.indices[3 * tri + 1]] - wr.origin;
+        Vec3 c = mesh.positions[mesh.indices[3 * tri + 2]] - wr.origin;
+
+        double ax = a[wr.kx] - wr.sx * a[wr.kz], ay = a[wr.ky] - wr.sy * a[wr.kz];
+        double bx = b[wr.kx] - wr.sx * b[wr.kz], by = b[wr.ky] - wr.sy * b[wr.kz];
+        double cx = c[wr.kx] - wr.sx * c[wr.kz], cy = c[wr.ky] - wr.sy * c[wr.kz];
+
+        double e0 = cx * by - cy * bx;
+        double e1 = ax * cy - ay * cx;
+        double e2 = bx * ay - by * ax;
+
+        if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
+            return false;
+        double det = e0 + e1 + e2;
+        if (det == 0)
+            return false;
+
+        double scaled_t = e0 * (wr.sz * a[wr.kz]) + e1 * (wr.sz * b[wr.kz]) + e2 * (wr.sz * c[wr.kz]);
+        double inv_det = 1.0 / det;
+        t = scaled_t * inv_det;
+        if (!ray_t.surrounds(t))
+            return false;
+
+        b1 = e1 * inv_det;
+        b2 = e2 * inv_det;
+        return true;
+    }
+
+    void fill_record(const RTRay& r, double t, uint32_t tri, double b1, double b2, HitRecord& rec) const {
+        const MeshView& mesh = view;
+        uint32_t i0 = mesh.indices[3 * tri + 0];
+        uint32_t i1 = mesh.indices[3 * tri + 1];
+        uint32_t i2 = mesh.indices[3 * tri + 2];
+        double b0 = 1.0 - b1 - b2;
+
+        rec.t = t;
+        rec.p = r.at(t);
+        rec.mat = mat.get();
+
+        Vec3 geometric = unit_vector(cross(mesh.positions[i1] - mesh.positions[i0],
+                                           mesh.positions[i2] - mesh.positions[i0]));
+        rec.set_face_normal(r, geometric);
+
+        if (mesh.normals) {
+            // Shade with the interpolated normal, kept on the side the ray
+            // arrived from so front_face stays geometric.
+            Vec3 shading = unit_vector(b0 * mesh.normals[i0] + b1 * mesh.normals[i1] + b2 * mesh.normals[i2]);
+            rec.normal = dot(shading, rec.normal) < 0 ? -shading : shading;
+        }
+
+        if (mesh.texcoords) {
+            rec.u = b0 * mesh.texcoords[i0].u + b1 * mesh.texcoords[i1].u + b2 * mesh.texcoords[i2].u;
+            rec.v = b0 * mesh.texcoords[i0].v + b1 * mesh.texcoords[i1].v + b2 * mesh.texcoords[i2].v;
+        } else {
+            rec.u = b1;
+            rec.v = b2;
+        }
+    }
+
+    std::shared_ptr<const void> storage;
+    std::shared_ptr<RTMaterial> mat;
+    LinearBVH tree;
+    MeshView view;
+    BVHBuildStats stats;
+    AABB bbox;
+};
+
+
+#endif
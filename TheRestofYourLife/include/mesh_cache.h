@@ -0,0 +1,37 @@
+#ifndef RT_MESH_CACHE_H
+#define RT_MESH_CACHE_H
+
+#include "mesh.h"
+
+#include <memory>
+#include <string>
+
+// Binary mesh cache ("RTMESH" files). A cache holds a mesh's vertex and index
+// buffers together with its flattened BVH (nodes + primitive order), each
+// array 64-byte aligned, so opening one is a single mmap: the TriangleMesh
+// reads straight from the mapped pages and nothing is parsed, copied or
+// rebuilt. Files record the format version, the byte order, the size and
+// modification time of the source they were made from and the box the mesh
+// was fitted to; a cache that doesn't match any of these is rejected and
+// rebuilt.
+
+// Writes `mesh` (built from `source_path` and fitted to `fit`, empty for
+// none) to `cache_path`. The file is written under a temporary name and
+// renamed into place, so a reader never sees a half-written cache.
+bool write_mesh_cache(const std::string& cache_path, const std::string& source_path, const AABB& fit,
+                      const TriangleMesh& mesh);
+
+// Maps `cache_path` and returns a TriangleMesh reading from it, or nullptr if
+// the file is missing, malformed, older than `source_path` or fitted to a
+// different box. Every vertex, triangle and node index in the file is
+// checked once here, so a damaged cache is rejected rather than traversed.
+std::shared_ptr<TriangleMesh> open_mesh_cache(const std::string& cache_path, const std::string& source_path,
+                                              const AABB& fit, std::shared_ptr<RTMaterial> mat);
+
+// Loads an OBJ file through its cache `<obj_path>.rtmesh`, rebuilding the
+// cache when needed: the OBJ is parsed, scaled into `fit` with
+// MeshData::fit_to (unless `fit` is empty) and its BVH built.
+std::shared_ptr<TriangleMesh> load_obj_cached(const std::string& obj_path, std::shared_ptr<RTMaterial> mat,
+                                              const AABB& fit = AABB());
+
+#endif
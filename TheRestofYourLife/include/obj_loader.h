@@ -0,0 +1,15 @@
+#ifndef RT_OBJ_LOADER_H
+#define RT_OBJ_LOADER_H
+
+#include "mesh.h"
+
+#include <memory>
+#include <string>
+
+// Loads the geometry of a Wavefront OBJ file: v/vt/vn records and f records
+// in any of the v, v/vt, v//vn and v/vt/vn forms (negative indices allowed,
+// polygons fan-triangulated). Materials, groups and smoothing are ignored.
+// Prints an error and returns nullptr if the file cannot be read or parsed.
+std::shared_ptr<MeshData> load_obj(const std::string& path);
+
+#endif
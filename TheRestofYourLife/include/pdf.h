@@ -3,7 +3,8 @@
 
 #include "rtweekend.h"
 #include "onb.h"
-#include "hittable.h"
+
+#include <variant>
 
 class Pdf {
 public:
@@ -30,40 +31,41 @@ private:
     Onb uvw;
 };
 
-class HittablePdf : public Pdf {
+class SpherePdf : public Pdf {
 public:
-    HittablePdf(const Hittable& _objects, const Point3& _origin)
-        : objects(_objects), origin(_origin) {}
+    SpherePdf() {}
 
-    double value(const Vec3& direction) const override {
-        return objects.pdf_value(origin, direction);
+    double value(const Vec3&) const override {
+        return 1 / (4 * pi);
     }
+
     Vec3 generate() const override {
-        return objects.random(origin);
+        return random_unit_vector();
     }
-
-private:
-    const Hittable& objects;
-    Point3 origin;
 };
 
-class MixturePdf : public Pdf {
+// The PDF a material hands back from scatter(), held by value inside
+// ScatterRecord so a bounce never touches the heap.
+class ScatterPdf : public Pdf {
 public:
-    MixturePdf(std::shared_ptr<Pdf> p0, std::shared_ptr<Pdf> p1) {
-        p[0] = p0;
-        p[1] = p1;
+    ScatterPdf() {}
+
+    template <typename T>
+    ScatterPdf& operator=(const T& other) {
+        pdf = other;
+        return *this;
     }
+
     double value(const Vec3& direction) const override {
-        return 0.5 * p[0]->value(direction) + 0.5 * p[1]->value(direction);
+        return std::visit([&](const auto& p) { return p.value(direction); }, pdf);
     }
+
     Vec3 generate() const override {
-        if (random_double() < 0.5)
-            return p[0]->generate();
-        else
-            return p[1]->generate();
+        return std::visit([](const auto& p) { return p.generate(); }, pdf);
     }
+
 private:
-    std::shared_ptr<Pdf> p[2];
+    std::variant<SpherePdf, CosinePdf> pdf;
 };
 
 #endif
\ No newline at end of file
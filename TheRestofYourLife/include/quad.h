@@ -6,6 +6,7 @@
 #include "vec3.h"    
 
 #include <cmath>
+#include <limits>
 
 class Quad : public Hittable {
   public:
@@ -28,28 +29,94 @@ class Quad : public Hittable {
     AABB bounding_box() const override { return bbox; }
 
     bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
-        auto denom = dot(normal, r.direction);
-        if (std::fabs(denom) < 1e-8)
-            return false;
-        auto t = (D - dot(normal, r.origin)) / denom; 
-        if (!ray_t.contains(t))
-            return false;
-
-        auto intersection = r.at(t);
-        Vec3 planar_hitpt_vector = intersection - Q;
-        
-        auto alpha = dot(w, cross(planar_hitpt_vector, v));
-        auto beta = dot(w, cross(u, planar_hitpt_vector));
-
-        if (!is_interior(alpha, beta, rec))
+        real t, alpha, beta;
+        if (!hit_plane(r, ray_t, t, alpha, beta) || !is_interior(alpha, beta, rec))
             return false;
 
+        // is_interior() has already stored u and v.
         rec.t = t;
-        rec.p = intersection;
-        rec.mat = mat;
+        rec.object = this;
+        return true;
+    }
+
+    void set_surface(const RTRay& r, HitRecord& rec) const override {
+        rec.p = r.at(rec.t);
+        rec.mat = mat.get();
         rec.set_face_normal(r, normal);
+    }
 
-        return true;
+    bool occluded(const RTRay& r, interval ray_t) const override {
+        real t, alpha, beta;
+        HitRecord uv;
+        return hit_plane(r, ray_t, t, alpha, beta) && is_interior(alpha, beta, uv);
+    }
+
+    int hit_packet(const RayPacket<packet_width>& rays, int active, interval ray_t,
+                   real t_max[packet_width], HitRecord rec[packet_width]) const override {
+        return hit_packet<packet_width>(rays, active, ray_t, t_max, rec);
+    }
+
+    bool packet_hits() const override { return true; }
+
+    // Packet version of hit(): active lane i hits if the quad is crossed in
+    // [ray_t.min, t_max[i]]; then rec[i] records the hit, t_max[i] lowered to the
+    // hit and bit i of the returned mask set. The plane and barycentric tests
+    // run across all lanes; is_interior() only runs for active lanes that
+    // reach the plane in range.
+    template <int N>
+    int hit_packet(const RayPacket<N>& rays, int active, const interval& ray_t, real t_max[N], HitRecord rec[N]) const {
+        real denom[N], t[N];
+        dot(rays.direction, normal, denom);
+        dot(rays.origin, normal, t);
+
+        // Lanes that miss the plane or its range get t = NaN, which fails
+        // every comparison, keeping every array `real`-wide so the loop
+        // vectorizes.
+        real alpha[N], beta[N];
+        RT_LANE_LOOP
+        for (int i = 0; i < N; i++) {
+            real t_plane = (D - t[i]) / denom[i];
+            real px = rays.origin.x[i] + t_plane * rays.direction.x[i] - Q.x;
+            real py = rays.origin.y[i] + t_plane * rays.direction.y[i] - Q.y;
+            real pz = rays.origin.z[i] + t_plane * rays.direction.z[i] - Q.z;
+
+            // dot(w, cross(p, v)) and dot(w, cross(u, p)) written out.
+            alpha[i] = w.x * (py * v.z - pz * v.y) + w.y * (pz * v.x - px * v.z) + w.z * (px * v.y - py * v.x);
+            beta[i] = w.x * (u.y * pz - u.z * py) + w.y * (u.z * px - u.x * pz) + w.z * (u.x * py - u.y * px);
+            bool in_range = (std::fabs(denom[i]) >= 1e-8) & (ray_t.min <= t_plane) & (t_plane <= t_max[i]);
+            t[i] = in_range ? t_plane : std::numeric_limits<real>::quiet_NaN();
+        }
+
+        int mask = 0;
+        for (int i = 0; i < N; i++) {
+            if (!((active >> i) & 1) || !(t[i] <= t_max[i]) || !is_interior(alpha[i], beta[i], rec[i]))
+                continue;
+            rec[i].t = t[i];
+            rec[i].object = this;
+            t_max[i] = t[i];
+            mask |= 1 << i;
+        }
+        return mask;
+    }
+
+    // Solid-angle density of a direction from `origin` that hits the quad:
+    // the area density 1 / area turned into one per steradian by the
+    // distance squared and the cosine at the light.
+    double pdf_value(const Point3& origin, const Vec3& direction) const override {
+        HitRecord rec;
+        if (!hit(RTRay(origin, direction), interval(0.001, infinity), rec))
+            return 0;
+
+        auto distance_squared = rec.t * rec.t * direction.length_squared();
+        auto cosine = std::fabs(dot(direction, normal) / direction.length());
+
+        return distance_squared / (cosine * area);
+    }
+
+    // A direction from `origin` to a uniformly chosen point on the quad.
+    Vec3 random(const Point3& origin) const override {
+        auto p = Q + (random_double() * u) + (random_double() * v);
+        return p - origin;
     }
 
     virtual bool is_interior(double a, double b, HitRecord& rec) const {
@@ -62,6 +129,22 @@ class Quad : public Hittable {
     }
 
   private:
+    // Where `r` crosses the quad's plane within ray_t, as t and as the
+    // (alpha, beta) coordinates along u and v that is_interior() tests.
+    bool hit_plane(const RTRay& r, const interval& ray_t, real& t, real& alpha, real& beta) const {
+        auto denom = dot(normal, r.direction);
+        if (std::fabs(denom) < 1e-8)
+            return false;
+        t = (D - dot(normal, r.origin)) / denom;
+        if (!ray_t.contains(t))
+            return false;
+
+        Vec3 planar_hitpt_vector = r.at(t) - Q;
+        alpha = dot(w, cross(planar_hitpt_vector, v));
+        beta = dot(w, cross(u, planar_hitpt_vector));
+        return true;
+    }
+
     Point3 Q;
     Vec3 u, v;
     Vec3 w;
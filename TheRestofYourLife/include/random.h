@@ -0,0 +1,64 @@
+#ifndef RT_RANDOM_H
+#define RT_RANDOM_H
+
+#include <atomic>
+#include <cstdint>
+
+// PCG32 (O'Neill, pcg-random.org): 64-bit LCG state with a permuted 32-bit output.
+// Every render thread owns one, so sampling never touches shared state.
+class Pcg32 {
+public:
+    Pcg32(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0xda3e39cb94b95bdbULL) {
+        reseed(seed, stream);
+    }
+
+    void reseed(uint64_t seed, uint64_t stream) {
+        state = 0;
+        inc = (stream << 1u) | 1u;
+        next_uint();
+        state += seed;
+        next_uint();
+    }
+
+    uint32_t next_uint() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = uint32_t(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31u));
+    }
+
+    double next_double() {
+        return next_uint() * (1.0 / 4294967296.0);
+    }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+inline Pcg32& thread_rng() {
+    static std::atomic<uint64_t> next_stream{0};
+    thread_local Pcg32 rng(0x853c49e6748fea9bULL, next_stream++);
+    return rng;
+}
+
+// Restarts the calling thread's sequence. The render loops seed per pixel and
+// per frame, so an image does not depend on which thread traced which pixel.
+inline void seed_thread_rng(uint64_t seed, uint64_t stream = 0) {
+    thread_rng().reseed(seed, stream);
+}
+
+inline double random_double() {
+    return thread_rng().next_double();
+}
+
+inline double random_double(double min, double max) {
+    return min + (max-min)*random_double();
+}
+
+inline int random_int(int min, int max) {
+    return int(random_double(min, max+1));
+}
+
+#endif
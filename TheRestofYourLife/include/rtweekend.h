@@ -25,19 +25,7 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
-inline double random_double() {
-    return std::rand() / (RAND_MAX + 1.0);
-}
-
-inline double random_double(double min, double max) {
-    return min + (max-min)*random_double();
-}
-
-inline int random_int(int min, int max) {
-    return int(random_double(min, max+1));
-}
-
-
+#include "random.h"
 #include "interval.h"
 #include "ray.h"
 #include "vec3.h"
@@ -55,5 +43,19 @@ inline Vec3 random_cosine_direction() {
     return Vec3(x, y, z);
 }
 
+// A direction, about +z, uniform over the cone of directions that hit a
+// sphere of `radius` whose center is sqrt(distance_squared) away along +z.
+inline Vec3 random_to_sphere(double radius, double distance_squared) {
+    auto r1 = random_double();
+    auto r2 = random_double();
+    auto z = 1 + r2 * (sqrt(1 - radius * radius / distance_squared) - 1);
+
+    auto phi = 2 * pi * r1;
+    auto x = cos(phi) * sqrt(1 - z * z);
+    auto y = sin(phi) * sqrt(1 - z * z);
+
+    return Vec3(x, y, z);
+}
+
 
 #endif
\ No newline at end of file
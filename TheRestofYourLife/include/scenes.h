@@ -0,0 +1,32 @@
+#ifndef RT_SCENES_H
+#define RT_SCENES_H
+
+#include "camera.h"
+#include "hittable.h"
+
+#include <memory>
+#include <string>
+
+class RTMaterial;
+
+struct Scene {
+    HittableList world;
+    HittableList lights;
+    RTCamera camera;
+};
+
+std::shared_ptr<HittableList> box(const Point3& a, const Point3& b, std::shared_ptr<RTMaterial> mat);
+Scene cornell_room(double aspect_ratio);
+Scene cornell_box(double aspect_ratio);
+
+// The empty Cornell room with the mesh from `obj_path` scaled to stand in
+// the middle of the floor. Returns false if the OBJ cannot be loaded.
+bool cornell_mesh(const std::string& obj_path, double aspect_ratio, Scene& scene);
+
+// Builds the named scene (empty selects "cornell", "obj:<path>" selects
+// cornell_mesh, a name ending in ".scene" is read with load_scene_file) with
+// its light list and camera. Prints the available names and returns false
+// when `name` is unknown.
+bool make_scene(const std::string& name, double aspect_ratio, Scene& scene);
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef RT_SCHEDULER_H
+#define RT_SCHEDULER_H
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+struct Tile {
+    int x0, y0;
+    int x1, y1;
+};
+
+struct TileTiming {
+    int worker;
+    bool stolen;
+    double ms;
+};
+
+struct TileStats {
+    int tiles = 0;
+    int workers = 0;
+    int steals = 0;
+    double frame_ms = 0;
+    double min_ms = 0;
+    double mean_ms = 0;
+    double max_ms = 0;
+};
+
+// Splits the frame into square tiles and hands each worker a contiguous run of
+// them. A worker drains its own deque from the front; once it is empty it steals
+// from the back of the other workers' deques, so expensive regions (glass,
+// volumes) do not leave the rest of the pool idle at the end of a frame.
+class TileScheduler {
+public:
+    TileScheduler(int width, int height, int tile_size = 32) {
+        for (int y = 0; y < height; y += tile_size)
+            for (int x = 0; x < width; x += tile_size)
+                tiles.push_back({x, y, std::min(x + tile_size, width), std::min(y + tile_size, height)});
+        timings.resize(tiles.size());
+    }
+
+    template <typename Body>
+    void run(const Body& render_tile) {
+        using clock = std::chrono::steady_clock;
+        auto frame_start = clock::now();
+
+        int tile_count = int(tiles.size());
+        int workers = std::max(1, std::min(render_threads(), tile_count));
+        std::vector<WorkerQueue> queues(workers);
+        for (int w = 0; w < workers; ++w)
+            for (int t = tile_count * w / workers; t < tile_count * (w + 1) / workers; ++t)
+                queues[w].tiles.push_back(t);
+
+        std::atomic<int> steals(0);
+
+        run_workers(workers, [&](int worker) {
+            int index;
+            bool stolen;
+            while (next_tile(queues, worker, index, stolen)) {
+                auto start = clock::now();
+                render_tile(tiles[index]);
+                std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+
+                timings[index] = {worker, stolen, elapsed.count()};
+                if (stolen) steals++;
+            }
+        });
+
+        std::chrono::duration<double, std::milli> frame = clock::now() - frame_start;
+        summarize(workers, steals, frame.count());
+    }
+
+    const std::vector<Tile>& tile_list() const { return tiles; }
+    const std::vector<TileTiming>& tile_timings() const { return timings; }
+    const TileStats& last_stats() const { return stats; }
+
+    void write_timings(std::ostream& out) const {
+        out << "tile,x0,y0,x1,y1,worker,stolen,ms\n";
+        for (size_t t = 0; t < tiles.size(); ++t) {
+            out << t << ',' << tiles[t].x0 << ',' << tiles[t].y0 << ','
+                << tiles[t].x1 << ',' << tiles[t].y1 << ','
+                << timings[t].worker << ',' << timings[t].stolen << ',' << timings[t].ms << '\n';
+        }
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<int> tiles;
+    };
+
+    std::vector<Tile> tiles;
+    std::vector<TileTiming> timings;
+    TileStats stats;
+
+    static bool next_tile(std::vector<WorkerQueue>& queues, int worker, int& index, bool& stolen) {
+        {
+            WorkerQueue& own = queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.tiles.empty()) {
+                index = own.tiles.front();
+                own.tiles.pop_front();
+                stolen = false;
+                return true;
+            }
+        }
+
+        int workers = int(queues.size());
+        for (int offset = 1; offset < workers; ++offset) {
+            WorkerQueue& victim = queues[(worker + offset) % workers];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tiles.empty()) {
+                index = victim.tiles.back();
+                victim.tiles.pop_back();
+                stolen = true;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void summarize(int workers, int steals, double frame_ms) {
+        stats.tiles = int(tiles.size());
+        stats.workers = workers;
+        stats.steals = steals;
+        stats.frame_ms = frame_ms;
+        stats.min_ms = timings.empty() ? 0 : timings[0].ms;
+        stats.max_ms = 0;
+
+        double total = 0;
+        for (const auto& timing : timings) {
+            stats.min_ms = std::min(stats.min_ms, timing.ms);
+            stats.max_ms = std::max(stats.max_ms, timing.ms);
+            total += timing.ms;
+        }
+        stats.mean_ms = timings.empty() ? 0 : total / timings.size();
+    }
+};
+
+#endif
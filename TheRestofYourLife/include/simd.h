@@ -0,0 +1,120 @@
+#ifndef RT_SIMD_H
+#define RT_SIMD_H
+
+#include "ray.h"
+#include "vec3.h"
+
+#include <cmath>
+
+// Structure-of-arrays vectors and ray packets, N lanes of `real` each.
+//
+// Every operation is a fixed-trip-count loop over plain arrays rather than
+// hand-written intrinsics: at -O3 GCC, Clang and MSVC turn these into SSE2,
+// AVX or NEON instructions for whatever target and RT_SCALAR the build uses,
+// and the same code stays correct (if slower) where nothing vectorizes. Keep
+// the loop bodies free of calls, early exits and bool arrays so they stay
+// vectorizable; per-lane results come back as a bit mask, lane i in bit i.
+
+const int packet_width = 4;
+
+// Put before a lane loop with a long body. Once such a loop is inlined into a
+// caller's loop, GCC unrolls it completely into scalar code before the
+// vectorizer gets to see it; keeping it rolled gets vector instructions.
+#if defined(__clang__)
+#define RT_LANE_LOOP _Pragma("clang loop vectorize(enable)")
+#elif defined(__GNUC__)
+#define RT_LANE_LOOP _Pragma("GCC unroll 1")
+#else
+#define RT_LANE_LOOP
+#endif
+
+template <int N>
+struct alignas(N * sizeof(real)) Vec3xN {
+    real x[N], y[N], z[N];
+
+    Vec3 get(int i) const { return Vec3(x[i], y[i], z[i]); }
+
+    void set(int i, const Vec3& v) {
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+    }
+};
+
+using Vec3x4 = Vec3xN<4>;
+using Vec3x8 = Vec3xN<8>;
+
+template <int N>
+inline void dot(const Vec3xN<N>& a, const Vec3xN<N>& b, real out[N]) {
+    for (int i = 0; i < N; i++)
+        out[i] = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i];
+}
+
+// Dot product of every lane of `a` with the same vector `b`.
+template <int N>
+inline void dot(const Vec3xN<N>& a, const Vec3& b, real out[N]) {
+    for (int i = 0; i < N; i++)
+        out[i] = a.x[i] * b.x + a.y[i] * b.y + a.z[i] * b.z;
+}
+
+template <int N>
+inline Vec3xN<N> cross(const Vec3xN<N>& a, const Vec3xN<N>& b) {
+    Vec3xN<N> c;
+    for (int i = 0; i < N; i++) {
+        c.x[i] = a.y[i] * b.z[i] - a.z[i] * b.y[i];
+        c.y[i] = a.z[i] * b.x[i] - a.x[i] * b.z[i];
+        c.z[i] = a.x[i] * b.y[i] - a.y[i] * b.x[i];
+    }
+    return c;
+}
+
+template <int N>
+inline Vec3xN<N> unit_vector(const Vec3xN<N>& a) {
+    Vec3xN<N> u;
+    for (int i = 0; i < N; i++) {
+        real inv_length = 1 / std::sqrt(a.x[i] * a.x[i] + a.y[i] * a.y[i] + a.z[i] * a.z[i]);
+        u.x[i] = a.x[i] * inv_length;
+        u.y[i] = a.y[i] * inv_length;
+        u.z[i] = a.z[i] * inv_length;
+    }
+    return u;
+}
+
+// a + t * b, lane by lane.
+template <int N>
+inline Vec3xN<N> multiply_add(const Vec3xN<N>& a, const real t[N], const Vec3xN<N>& b) {
+    Vec3xN<N> r;
+    for (int i = 0; i < N; i++) {
+        r.x[i] = a.x[i] + t[i] * b.x[i];
+        r.y[i] = a.y[i] + t[i] * b.y[i];
+        r.z[i] = a.z[i] + t[i] * b.z[i];
+    }
+    return r;
+}
+
+// N rays sharing nothing but their storage; usually the primary rays of
+// neighbouring pixels or samples, so they tend to hit the same objects.
+template <int N>
+struct RayPacket {
+    Vec3xN<N> origin;
+    Vec3xN<N> direction;
+    real tm[N];
+
+    // The rays the lanes were filled from, if they are still around, so code
+    // that handles one lane at a time can use them instead of rebuilding each
+    // ray (and its inverse direction) with ray().
+    const RTRay* source = nullptr;
+
+    RTRay ray(int i) const { return RTRay(origin.get(i), direction.get(i), tm[i]); }
+
+    void set(int i, const RTRay& r) {
+        origin.set(i, r.origin);
+        direction.set(i, r.direction);
+        tm[i] = r.tm;
+    }
+};
+
+using RayPacket4 = RayPacket<4>;
+using RayPacket8 = RayPacket<8>;
+
+#endif
@@ -17,10 +17,24 @@ public:
         if (!object->hit(offset_r, ray_t, rec))
             return false;
 
+        // The surface is moved into place here, so it has to be there now.
+        finish_hit(offset_r, rec);
         rec.p += offset;
         return true;
     }
 
+    bool occluded(const RTRay& r, interval ray_t) const override {
+        return object->occluded(RTRay(r.origin - offset, r.direction), ray_t);
+    }
+
+    double pdf_value(const Point3& origin, const Vec3& v) const override {
+        return object->pdf_value(origin - offset, v);
+    }
+
+    Vec3 random(const Point3& origin) const override {
+        return object->random(origin - offset);
+    }
+
     AABB bounding_box() const override {
         return bbox;
     }
@@ -77,20 +91,12 @@ public:
     }
 
     bool hit(const RTRay& r, interval ray_t, HitRecord& rec) const override {
-        auto origin = r.origin;
-        auto direction = r.direction;
-
-        origin[0] = cos_theta * r.origin[0] - sin_theta * r.origin[2];
-        origin[2] = sin_theta * r.origin[0] + cos_theta * r.origin[2];
-
-        direction[0] = cos_theta * r.direction[0] - sin_theta * r.direction[2];
-        direction[2] = sin_theta * r.direction[0] + cos_theta * r.direction[2];
-
-        RTRay rotated_r(origin, direction);
-
+        RTRay rotated_r = rotate(r);
         if (!object->hit(rotated_r, ray_t, rec))
             return false;
 
+        finish_hit(rotated_r, rec);
+
         auto p = rec.p;
         p[0] =  cos_theta * rec.p[0] + sin_theta * rec.p[2];
         p[2] = -sin_theta * rec.p[0] + cos_theta * rec.p[2];
@@ -105,6 +111,18 @@ public:
         return true;
     }
 
+    bool occluded(const RTRay& r, interval ray_t) const override {
+        return object->occluded(rotate(r), ray_t);
+    }
+
+    double pdf_value(const Point3& origin, const Vec3& v) const override {
+        return object->pdf_value(to_object(origin), to_object(v));
+    }
+
+    Vec3 random(const Point3& origin) const override {
+        return to_world(object->random(to_object(origin)));
+    }
+
     AABB bounding_box() const override {
         return bbox;
     }
@@ -114,6 +132,19 @@ private:
     double sin_theta;
     double cos_theta;
     AABB bbox;
+
+    // `r` in the object's frame.
+    RTRay rotate(const RTRay& r) const {
+        return RTRay(to_object(r.origin), to_object(r.direction));
+    }
+
+    Vec3 to_object(const Vec3& v) const {
+        return Vec3(cos_theta * v[0] - sin_theta * v[2], v[1], sin_theta * v[0] + cos_theta * v[2]);
+    }
+
+    Vec3 to_world(const Vec3& v) const {
+        return Vec3(cos_theta * v[0] + sin_theta * v[2], v[1], -sin_theta * v[0] + cos_theta * v[2]);
+    }
 };
 
 #endif
\ No newline at end of file
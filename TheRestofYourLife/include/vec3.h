@@ -3,20 +3,25 @@
 
 #include <cmath>
 #include <iostream>
-#include <cstdlib>
+#include "random.h"
+#include "real.h"
 
 using std::sqrt;
 
 class Vec3 {
 public:
-    double x, y, z;
+    real x, y, z;
+
+    static constexpr real Vec3::* axes[3] = {&Vec3::x, &Vec3::y, &Vec3::z};
 
     Vec3() : x(0), y(0), z(0) {}
-    Vec3(double e0, double e1, double e2) : x(e0), y(e1), z(e2) {}
+    Vec3(real e0, real e1, real e2) : x(e0), y(e1), z(e2) {}
 
     Vec3 operator-() const { return Vec3(-x, -y, -z); }
-    double operator[](int i) const { return (i==0) ? x : ((i==1) ? y : z); }
-    double& operator[](int i) { return (i==0) ? x : ((i==1) ? y : z); }
+    // Indexes through a member-pointer table instead of comparing i, so a
+    // loop over axes compiles to a load rather than a chain of branches.
+    real operator[](int i) const { return this->*axes[i]; }
+    real& operator[](int i) { return this->*axes[i]; }
 
     Vec3& operator+=(const Vec3 &v) {
         x += v.x;
@@ -25,33 +30,31 @@ public:
         return *this;
     }
 
-    Vec3& operator*=(const double t) {
+    Vec3& operator*=(const real t) {
         x *= t;
         y *= t;
         z *= t;
         return *this;
     }
 
-    Vec3& operator/=(const double t) {
+    Vec3& operator/=(const real t) {
         return *this *= 1/t;
     }
 
-    double length() const {
+    real length() const {
         return sqrt(length_squared());
     }
 
-    double length_squared() const {
+    real length_squared() const {
         return x*x + y*y + z*z;
     }
 
     static Vec3 random() {
-        return Vec3(std::rand() / (RAND_MAX + 1.0), std::rand() / (RAND_MAX + 1.0), std::rand() / (RAND_MAX + 1.0));
+        return Vec3(random_double(), random_double(), random_double());
     }
 
-    static Vec3 random(double min, double max) {
-        return Vec3(min + (max-min)*(std::rand() / (RAND_MAX + 1.0)),
-                    min + (max-min)*(std::rand() / (RAND_MAX + 1.0)),
-                    min + (max-min)*(std::rand() / (RAND_MAX + 1.0)));
+    static Vec3 random(real min, real max) {
+        return Vec3(random_double(min, max), random_double(min, max), random_double(min, max));
     }
 };
 
@@ -74,19 +77,19 @@ inline Vec3 operator*(const Vec3 &u, const Vec3 &v) {
     return Vec3(u.x * v.x, u.y * v.y, u.z * v.z);
 }
 
-inline Vec3 operator*(double t, const Vec3 &v) {
+inline Vec3 operator*(real t, const Vec3 &v) {
     return Vec3(t*v.x, t*v.y, t*v.z);
 }
 
-inline Vec3 operator*(const Vec3 &v, double t) {
+inline Vec3 operator*(const Vec3 &v, real t) {
     return t * v;
 }
 
-inline Vec3 operator/(Vec3 v, double t) {
+inline Vec3 operator/(Vec3 v, real t) {
     return (1/t) * v;
 }
 
-inline double dot(const Vec3 &u, const Vec3 &v) {
+inline real dot(const Vec3 &u, const Vec3 &v) {
     return u.x * v.x + u.y * v.y + u.z * v.z;
 }
 
@@ -120,7 +123,7 @@ inline Vec3 reflect(const Vec3& v, const Vec3& n) {
     return v - 2*dot(v,n)*n;
 }
 
-inline Vec3 refract(const Vec3& uv, const Vec3& n, double etai_over_etat) {
+inline Vec3 refract(const Vec3& uv, const Vec3& n, real etai_over_etat) {
     auto cos_theta = fmin(dot(-uv, n), 1.0);
     Vec3 r_out_perp =  etai_over_etat * (uv + cos_theta*n);
     Vec3 r_out_parallel = -sqrt(fabs(1.0 - r_out_perp.length_squared())) * n;
@@ -6,116 +6,59 @@
 #include "material.h"
 #include "quad.h"
 #include "pdf.h" 
+#include "scheduler.h"
+#include "headless.h"
+#include "adaptive.h"
+#include "integrator.h"
+#include "scenes.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <memory>
-
-inline double clamp(double x, double min, double max) {
-    if (x < min) return min;
-    if (x > max) return max;
-    return x;
-}
-
-inline std::shared_ptr<HittableList> box(const Point3& a, const Point3& b, std::shared_ptr<RTMaterial> mat) {
-    auto sides = std::make_shared<HittableList>();
-    auto min = Point3(std::fmin(a.x, b.x), std::fmin(a.y, b.y), std::fmin(a.z, b.z));
-    auto max = Point3(std::fmax(a.x, b.x), std::fmax(a.y, b.y), std::fmax(a.z, b.z));
-    Vec3 dx = Vec3(max.x - min.x, 0, 0);
-    Vec3 dy = Vec3(0, max.y - min.y, 0);
-    Vec3 dz = Vec3(0, 0, max.z - min.z);
-    sides->add(std::make_shared<Quad>(Point3(min.x, min.y, max.z),  dx,  dy, mat)); 
-    sides->add(std::make_shared<Quad>(Point3(max.x, min.y, max.z), -dz,  dy, mat)); 
-    sides->add(std::make_shared<Quad>(Point3(max.x, min.y, min.z), -dx,  dy, mat)); 
-    sides->add(std::make_shared<Quad>(Point3(min.x, min.y, min.z),  dz,  dy, mat)); 
-    sides->add(std::make_shared<Quad>(Point3(min.x, max.y, max.z),  dx, -dz, mat)); 
-    sides->add(std::make_shared<Quad>(Point3(min.x, min.y, min.z),  dx,  dz, mat)); 
-    return sides;
-}
-
-Color3 ray_color(const RTRay& r, int depth, const Hittable& world, const Hittable& lights) {
-    if (depth <= 0) return Color3(0,0,0);
-
-    HitRecord rec;
-    if (!world.hit(r, interval(0.001, infinity), rec))
-        return Color3(0,0,0);
-
-    ScatterRecord srec;
-    
-    Color3 color_from_emission = rec.mat->emitted(r, rec, rec.u, rec.v, rec.p);
-
-    if (!rec.mat->scatter(r, rec, srec))
-        return color_from_emission;
-
-    if (srec.skip_pdf) {
-        return srec.attenuation * ray_color(srec.skip_pdf_ray, depth-1, world, lights);
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    RenderOptions options;
+    if (!parse_render_options(argc, argv, options))
+        return 1;
+
+    const int screenWidth = options.width > 0 ? options.width : 600;
+    const int screenHeight = options.height > 0 ? options.height : 600;
+    const int max_depth = options.max_depth > 0 ? options.max_depth : 50;
+
+    Scene scene;
+    if (!make_scene(options.scene, double(screenWidth)/screenHeight, scene))
+        return 1;
+    const HittableList& world = scene.world;
+    const HittableList& lights = scene.lights;
+    RTCamera& cam = scene.camera;
+
+    if (options.headless) {
+        int spp = options.samples_per_pixel > 0 ? options.samples_per_pixel : 100;
+        std::vector<Color3> buffer = render_headless(screenWidth, screenHeight, spp, [&](int i, int j) {
+            double u = (double(i) + random_double()) / (screenWidth - 1);
+            double v = (double(screenHeight - 1 - j) + random_double()) / (screenHeight - 1);
+            return ray_color(cam.get_ray(u, v), max_depth, world, lights);
+        });
+        return write_image(options.output, buffer, screenWidth, screenHeight, spp) ? 0 : 1;
     }
 
-    auto light_ptr = std::make_shared<HittablePdf>(lights, rec.p);
-    MixturePdf mixed_pdf(light_ptr, srec.pdf_ptr);
-
-    RTRay scattered = RTRay(rec.p, mixed_pdf.generate(), r.tm);
-    double pdf_val = mixed_pdf.value(scattered.direction);
-
-    double scattering_pdf = rec.mat->scattering_pdf(r, rec, scattered);
-
-    if (pdf_val == 0) return color_from_emission;
-
-    return color_from_emission + 
-           (srec.attenuation * scattering_pdf * ray_color(scattered, depth-1, world, lights)) / pdf_val;
-}
-
-int main() {
-    const int screenWidth = 600;
-    const int screenHeight = 600;
-    const int max_depth = 50; 
-
     InitWindow(screenWidth, screenHeight, "Ray Tracer Book 3: Final");
     SetTargetFPS(60);
     DisableCursor();
 
-    HittableList world;
-
-    auto red   = std::make_shared<Lambertian>(Color3(.65, .05, .05));
-    auto white = std::make_shared<Lambertian>(Color3(.73, .73, .73));
-    auto green = std::make_shared<Lambertian>(Color3(.12, .45, .15));
-    auto light = std::make_shared<DiffuseLight>(Color3(15, 15, 15));
-    
-    auto aluminum = std::make_shared<Metal>(Color3(0.8, 0.85, 0.88), 0.5);
-    auto glass    = std::make_shared<Dielectric>(1.5);
-
-    world.add(std::make_shared<Quad>(Point3(555,0,0), Vec3(0,555,0), Vec3(0,0,555), green));
-    world.add(std::make_shared<Quad>(Point3(0,0,0), Vec3(0,555,0), Vec3(0,0,555), red));
-    world.add(std::make_shared<Quad>(Point3(343, 554, 332), Vec3(-130,0,0), Vec3(0,0,-105), light)); // Лампа
-    world.add(std::make_shared<Quad>(Point3(0,0,0), Vec3(555,0,0), Vec3(0,0,555), white)); // Пол
-    world.add(std::make_shared<Quad>(Point3(555,555,555), Vec3(-555,0,0), Vec3(0,0,-555), white)); // Потолок
-    world.add(std::make_shared<Quad>(Point3(0,0,555), Vec3(555,0,0), Vec3(0,555,0), white)); // Задняя стена
-
-    std::shared_ptr<Hittable> box1 = box(Point3(130, 0, 65), Point3(295, 165, 230), white); // Обычный белый куб
-    
-    world.add(std::make_shared<Sphere>(Point3(190, 90, 190), 90, glass));
-
-    std::shared_ptr<Hittable> box2 = box(Point3(265, 0, 295), Point3(430, 330, 460), aluminum);
-    world.add(box2);
-
-    HittableList lights;
-    lights.add(std::make_shared<Quad>(Point3(343, 554, 332), Vec3(-130,0,0), Vec3(0,0,-105), light));
-
-    RTCamera cam(
-        Point3(278, 278, -800),
-        Point3(278, 278, 0),
-        Vec3(0, 1, 0),
-        40.0,
-        double(screenWidth)/screenHeight,
-        0.0,
-        10.0
-    );
-
     Image image = GenImageColor(screenWidth, screenHeight, BLACK);
     Texture2D texture = LoadTextureFromImage(image);
     
-    std::vector<Color3> accumBuffer(screenWidth * screenHeight, Color3(0,0,0));
+    AdaptiveSampler sampler(screenWidth, screenHeight);
     int framesAccumulated = 0;
+    bool showDensity = false;
+
+    TileScheduler scheduler(screenWidth, screenHeight);
 
     while (!WindowShouldClose()) {
         double speed = 5.0; 
@@ -137,42 +80,51 @@ int main() {
 
         if (cameraMoved) {
             framesAccumulated = 0;
-            std::fill(accumBuffer.begin(), accumBuffer.end(), Color3(0,0,0));
+            sampler.reset();
         }
+        if (IsKeyPressed(KEY_M)) sampler.enabled = !sampler.enabled;
+        if (IsKeyPressed(KEY_V)) showDensity = !showDensity;
 
         framesAccumulated++;
 
-        #pragma omp parallel for 
-        for (int j = 0; j < screenHeight; ++j) {
-            for (int i = 0; i < screenWidth; ++i) {
-                double u = (double(i) + random_double()) / (screenWidth - 1);
-                double v = (double(screenHeight - 1 - j) + random_double()) / (screenHeight - 1);
-
-                RTRay r = cam.get_ray(u, v);
-                Color3 pixel_color = ray_color(r, max_depth, world, lights);
-
-                int pixelIndex = j * screenWidth + i;
-                accumBuffer[pixelIndex] += pixel_color;
-                Color3 accumulatedColor = accumBuffer[pixelIndex] / double(framesAccumulated);
-
-                if (accumulatedColor.x != accumulatedColor.x) accumulatedColor = Color3(0,0,0);
-                if (accumulatedColor.y != accumulatedColor.y) accumulatedColor = Color3(0,0,0);
-                if (accumulatedColor.z != accumulatedColor.z) accumulatedColor = Color3(0,0,0);
-
-                auto r_val = sqrt(accumulatedColor.x);
-                auto g_val = sqrt(accumulatedColor.y);
-                auto b_val = sqrt(accumulatedColor.z);
-
-                Color finalColor;
-                finalColor.r = (unsigned char)(256 * clamp(r_val, 0.0, 0.999));
-                finalColor.g = (unsigned char)(256 * clamp(g_val, 0.0, 0.999));
-                finalColor.b = (unsigned char)(256 * clamp(b_val, 0.0, 0.999));
-                finalColor.a = 255;
-
-                ((Color*)image.data)[pixelIndex] = finalColor;
-            }
-        }
-        
+        scheduler.run([&](const Tile& tile) {
+            for_each_pixel_block(tile, [&](const PixelBlock& block) {
+                // Each lane takes as many samples as the sampler asks of its
+                // pixel; the packet carries the lanes that still want one.
+                Pcg32 rng[packet_width];
+                int wanted[packet_width] = {};
+                int most = 0;
+                for (int lane = 0; lane < packet_width; ++lane) {
+                    if (!((block.active >> lane) & 1)) continue;
+                    int pixelIndex = block.j(lane) * screenWidth + block.i(lane);
+                    wanted[lane] = sampler.samples_for(pixelIndex, 1);
+                    most = std::max(most, wanted[lane]);
+                    seed_thread_rng(framesAccumulated, pixelIndex);
+                    rng[lane] = thread_rng();
+                }
+
+                for (int s = 0; s < most; ++s) {
+                    int active = 0;
+                    for (int lane = 0; lane < packet_width; ++lane)
+                        if (wanted[lane] > s) active |= 1 << lane;
+
+                    Color3 colors[packet_width];
+                    trace_camera_packet(active, rng, [&](int lane) {
+                        double u = (double(block.i(lane)) + random_double()) / (screenWidth - 1);
+                        double v = (double(screenHeight - 1 - block.j(lane)) + random_double()) / (screenHeight - 1);
+                        return cam.get_ray(u, v);
+                    }, max_depth, world, lights, colors);
+
+                    for (int lane = 0; lane < packet_width; ++lane)
+                        if ((active >> lane) & 1)
+                            sampler.add(block.j(lane) * screenWidth + block.i(lane), colors[lane]);
+                }
+            });
+        });
+
+        if (IsKeyPressed(KEY_T)) scheduler.write_timings(std::cout);
+
+        sampler.to_image(image, showDensity);
         UpdateTexture(texture, image.data);
 
         BeginDrawing();
@@ -180,6 +132,13 @@ int main() {
             DrawTexture(texture, 0, 0, WHITE);
             DrawFPS(10, 10);
             DrawText(TextFormat("Samples: %d", framesAccumulated), 10, 30, 20, GREEN);
+            DrawText(TextFormat("Threads: %d", render_threads()), 10, 50, 20, GREEN);
+            const TileStats& tiles = scheduler.last_stats();
+            DrawText(TextFormat("Tiles: %d  max %.1f ms  steals %d [T]", tiles.tiles, tiles.max_ms, tiles.steals), 10, 70, 20, GREEN);
+            AdaptiveSampler::Summary spp = sampler.summary(1);
+            DrawText(TextFormat("Adaptive [M]: %s  active %.0f%%  %.1f spp avg  %d max", sampler.enabled ? "on" : "off",
+                                100 * spp.active, spp.mean_samples, spp.max_samples), 10, 90, 20, GREEN);
+            DrawText(TextFormat("Density view [V]: %s", showDensity ? "on" : "off"), 10, 110, 20, GREEN);
         EndDrawing();
     }
 
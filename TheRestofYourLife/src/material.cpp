@@ -13,7 +13,7 @@ Lambertian::Lambertian(std::shared_ptr<RTTexture> tex) : tex(tex) {}
 
 bool Lambertian::scatter(const RTRay& r_in, const HitRecord& rec, ScatterRecord& srec) const {
     srec.attenuation = tex->value(rec.u, rec.v, rec.p);
-    srec.pdf_ptr = std::make_shared<CosinePdf>(rec.normal);
+    srec.pdf = CosinePdf(rec.normal);
     srec.skip_pdf = false;
     return true;
 }
@@ -59,4 +59,15 @@ bool Dielectric::scatter(const RTRay& r_in, const HitRecord& rec, ScatterRecord&
 
     srec.skip_pdf_ray = RTRay(rec.p, direction, r_in.tm);
     return true;
-}
\ No newline at end of file
+}
+
+bool Isotropic::scatter(const RTRay&, const HitRecord& rec, ScatterRecord& srec) const {
+    srec.attenuation = tex->value(rec.u, rec.v, rec.p);
+    srec.pdf = SpherePdf();
+    srec.skip_pdf = false;
+    return true;
+}
+
+double Isotropic::scattering_pdf(const RTRay&, const HitRecord&, const RTRay&) const {
+    return 1 / (4 * pi);
+}
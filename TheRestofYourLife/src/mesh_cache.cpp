@@ -0,0 +1,341 @@
+#include "mesh_cache.h"
+#include "obj_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char cache_magic[8] = { 'R', 'T', 'M', 'E', 'S', 'H', 0, 0 };
+const uint32_t cache_version = 2;
+const uint32_t cache_byte_order = 0x01020304;
+const uint64_t cache_alignment = 64;
+
+static_assert(std::is_trivially_copyable<Vec3>::value, "Vec3 is written to the cache as raw bytes");
+static_assert(std::is_trivially_copyable<MeshTexcoord>::value, "MeshTexcoord is written to the cache as raw bytes");
+static_assert(std::is_trivially_copyable<BVHLinearNode>::value, "BVHLinearNode is written to the cache as raw bytes");
+
+// Fixed-size file header. Array offsets are from the start of the file and
+// 0 for an absent array; the element sizes catch a cache written by a build
+// with a different Vec3 or node layout. `fit` is the fit_to() box as
+// min xyz, max xyz (an empty box when the mesh was not fitted).
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t vec3_size;
+    uint32_t texcoord_size;
+    uint32_t node_size;
+    uint32_t pad;
+    uint64_t source_size;
+    int64_t source_time;
+    double fit[6];
+    uint64_t vertex_count;
+    uint64_t triangle_count;
+    uint64_t node_count;
+    uint64_t positions_offset;
+    uint64_t normals_offset;
+    uint64_t texcoords_offset;
+    uint64_t indices_offset;
+    uint64_t nodes_offset;
+    uint64_t order_offset;
+};
+
+// Size and modification time of the file a cache was made from.
+bool source_stamp(const std::string& path, uint64_t& size, int64_t& time) {
+    std::error_code error;
+    size = std::filesystem::file_size(path, error);
+    if (error) return false;
+    auto modified = std::filesystem::last_write_time(path, error);
+    if (error) return false;
+    time = int64_t(modified.time_since_epoch().count());
+    return true;
+}
+
+void fit_values(const AABB& fit, double values[6]) {
+    for (int a = 0; a < 3; a++) {
+        values[a] = fit.axis(a).min;
+        values[3 + a] = fit.axis(a).max;
+    }
+}
+
+uint64_t align_offset(uint64_t offset) {
+    return (offset + cache_alignment - 1) / cache_alignment * cache_alignment;
+}
+
+// A whole file mapped read-only. Unmapped when the last TriangleMesh using
+// it goes away.
+class MappedFile {
+  public:
+    ~MappedFile() {
+#if defined(_WIN32)
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (base) munmap(base, length);
+#endif
+    }
+
+    bool open(const std::string& path) {
+#if defined(_WIN32)
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return false;
+        length = size_t(file_size.QuadPart);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return base != nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        length = size_t(info.st_size);
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        base = mapped;
+        return true;
+#endif
+    }
+
+    const unsigned char* data() const { return static_cast<const unsigned char*>(base); }
+    size_t size() const { return length; }
+
+  private:
+    void* base = nullptr;
+    size_t length = 0;
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+// True if `count` elements of `element_size` bytes at `offset` lie inside the
+// file and start on the cache alignment.
+bool array_fits(const MappedFile& file, uint64_t offset, uint64_t count, uint64_t element_size) {
+    if (offset % cache_alignment != 0 || offset < sizeof(CacheHeader) || offset > file.size())
+        return false;
+    return count <= (file.size() - offset) / element_size;
+}
+
+// True if every index in a mapped mesh stays inside the array it points
+// into: triangle corners below vertex_count, primitive_order entries below
+// triangle_count, leaves inside primitive_order, and interior nodes on a
+// valid axis with both children further down the node array and within the
+// traversal stack's depth. array_fits() only places the arrays in the file;
+// this keeps a corrupt or hand-edited cache from sending traversal outside
+// them.
+bool indices_valid(const MeshView& view) {
+    for (size_t k = 0; k < view.triangle_count * 3; k++)
+        if (view.indices[k] >= view.vertex_count)
+            return false;
+    for (size_t k = 0; k < view.triangle_count; k++)
+        if (view.primitive_order[k] >= view.triangle_count)
+            return false;
+
+    std::vector<uint8_t> depth(view.node_count, 0);
+    for (size_t i = 0; i < view.node_count; i++) {
+        const BVHLinearNode& node = view.nodes[i];
+        if (node.primitive_count > 0) {
+            if (uint64_t(node.offset) + node.primitive_count > view.triangle_count)
+                return false;
+            continue;
+        }
+        if (node.axis > 2 || node.offset <= i + 1 || node.offset >= view.node_count)
+            return false;
+        int child_depth = depth[i] + 1;
+        if (child_depth >= LinearBVH::traversal_stack_size)
+            return false;
+        depth[i + 1] = uint8_t(std::max<int>(depth[i + 1], child_depth));
+        depth[node.offset] = uint8_t(std::max<int>(depth[node.offset], child_depth));
+    }
+    return true;
+}
+
+void write_array(std::ofstream& out, uint64_t offset, const void* data, uint64_t bytes) {
+    out.seekp(std::streamoff(offset));
+    out.write(static_cast<const char*>(data), std::streamsize(bytes));
+}
+
+} // namespace
+
+bool write_mesh_cache(const std::string& cache_path, const std::string& source_path, const AABB& fit,
+                      const TriangleMesh& mesh) {
+    const MeshView& view = mesh.mesh_view();
+
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.byte_order = cache_byte_order;
+    header.vec3_size = sizeof(Vec3);
+    header.texcoord_size = sizeof(MeshTexcoord);
+    header.node_size = sizeof(BVHLinearNode);
+    if (!source_stamp(source_path, header.source_size, header.source_time)) {
+        std::cerr << "ERROR: Could not stat '" << source_path << "'.\n";
+        return false;
+    }
+    fit_values(fit, header.fit);
+    header.vertex_count = view.vertex_count;
+    header.triangle_count = view.triangle_count;
+    header.node_count = view.node_count;
+
+    uint64_t end = sizeof(CacheHeader);
+    auto place = [&](bool present, uint64_t bytes) {
+        if (!present) return uint64_t(0);
+        uint64_t offset = align_offset(end);
+        end = offset + bytes;
+        return offset;
+    };
+    header.positions_offset = place(true, view.vertex_count * sizeof(Point3));
+    header.normals_offset = place(view.normals != nullptr, view.vertex_count * sizeof(Vec3));
+    header.texcoords_offset = place(view.texcoords != nullptr, view.vertex_count * sizeof(MeshTexcoord));
+    header.indices_offset = place(true, view.triangle_count * 3 * sizeof(uint32_t));
+    header.nodes_offset = place(true, view.node_count * sizeof(BVHLinearNode));
+    header.order_offset = place(true, view.triangle_count * sizeof(uint32_t));
+
+    std::string temp_path = cache_path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "ERROR: Could not open '" << temp_path << "' for writing.\n";
+            return false;
+        }
+        write_array(out, 0, &header, sizeof(header));
+        write_array(out, header.positions_offset, view.positions, view.vertex_count * sizeof(Point3));
+        if (view.normals)
+            write_array(out, header.normals_offset, view.normals, view.vertex_count * sizeof(Vec3));
+        if (view.texcoords)
+            write_array(out, header.texcoords_offset, view.texcoords, view.vertex_count * sizeof(MeshTexcoord));
+        write_array(out, header.indices_offset, view.indices, view.triangle_count * 3 * sizeof(uint32_t));
+        write_array(out, header.nodes_offset, view.nodes, view.node_count * sizeof(BVHLinearNode));
+        write_array(out, header.order_offset, view.primitive_order, view.triangle_count * sizeof(uint32_t));
+        if (!out) {
+            std::cerr << "ERROR: Could not write '" << temp_path << "'.\n";
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, cache_path, error);
+    if (error) {
+        std::cerr << "ERROR: Could not replace '" << cache_path << "': " << error.message() << '\n';
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<TriangleMesh> open_mesh_cache(const std::string& cache_path, const std::string& source_path,
+                                              const AABB& fit, std::shared_ptr<RTMaterial> mat) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(cache_path) || file->size() < sizeof(CacheHeader))
+        return nullptr;
+
+    CacheHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != cache_version ||
+        header.byte_order != cache_byte_order || header.vec3_size != sizeof(Vec3) ||
+        header.texcoord_size != sizeof(MeshTexcoord) || header.node_size != sizeof(BVHLinearNode)) {
+        std::clog << "Mesh cache '" << cache_path << "' is from another version or platform, rebuilding\n";
+        return nullptr;
+    }
+
+    uint64_t source_size;
+    int64_t source_time;
+    if (!source_stamp(source_path, source_size, source_time) ||
+        source_size != header.source_size || source_time != header.source_time) {
+        std::clog << "Mesh cache '" << cache_path << "' is out of date, rebuilding\n";
+        return nullptr;
+    }
+
+    double fit_wanted[6];
+    fit_values(fit, fit_wanted);
+    for (int k = 0; k < 6; k++) {
+        if (header.fit[k] != fit_wanted[k]) {
+            std::clog << "Mesh cache '" << cache_path << "' was fitted to another box, rebuilding\n";
+            return nullptr;
+        }
+    }
+
+    bool valid = header.vertex_count > 0 && header.triangle_count > 0 && header.node_count > 0 &&
+        array_fits(*file, header.positions_offset, header.vertex_count, sizeof(Point3)) &&
+        (!header.normals_offset || array_fits(*file, header.normals_offset, header.vertex_count, sizeof(Vec3))) &&
+        (!header.texcoords_offset ||
+         array_fits(*file, header.texcoords_offset, header.vertex_count, sizeof(MeshTexcoord))) &&
+        header.triangle_count <= UINT32_MAX &&
+        array_fits(*file, header.indices_offset, header.triangle_count * 3, sizeof(uint32_t)) &&
+        array_fits(*file, header.nodes_offset, header.node_count, sizeof(BVHLinearNode)) &&
+        array_fits(*file, header.order_offset, header.triangle_count, sizeof(uint32_t));
+    if (!valid) {
+        std::clog << "Mesh cache '" << cache_path << "' is damaged, rebuilding\n";
+        return nullptr;
+    }
+
+    const unsigned char* base = file->data();
+    MeshView view;
+    view.positions = reinterpret_cast<const Point3*>(base + header.positions_offset);
+    view.normals = header.normals_offset ? reinterpret_cast<const Vec3*>(base + header.normals_offset) : nullptr;
+    view.texcoords = header.texcoords_offset
+        ? reinterpret_cast<const MeshTexcoord*>(base + header.texcoords_offset) : nullptr;
+    view.indices = reinterpret_cast<const uint32_t*>(base + header.indices_offset);
+    view.vertex_count = size_t(header.vertex_count);
+    view.triangle_count = size_t(header.triangle_count);
+    view.nodes = reinterpret_cast<const BVHLinearNode*>(base + header.nodes_offset);
+    view.node_count = size_t(header.node_count);
+    view.primitive_order = reinterpret_cast<const uint32_t*>(base + header.order_offset);
+    if (!indices_valid(view)) {
+        std::clog << "Mesh cache '" << cache_path << "' is damaged, rebuilding\n";
+        return nullptr;
+    }
+    return std::make_shared<TriangleMesh>(view, file, mat);
+}
+
+std::shared_ptr<TriangleMesh> load_obj_cached(const std::string& obj_path, std::shared_ptr<RTMaterial> mat,
+                                              const AABB& fit) {
+    std::string cache_path = obj_path + ".rtmesh";
+    auto start = std::chrono::steady_clock::now();
+    if (auto cached = open_mesh_cache(cache_path, obj_path, fit, mat)) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::clog << "Mapped mesh cache '" << cache_path << "' in " << ms << " ms\n";
+        return cached;
+    }
+
+    std::shared_ptr<MeshData> data = load_obj(obj_path);
+    if (!data)
+        return nullptr;
+    if (fit.x.size() >= 0)
+        data->fit_to(fit);
+
+    auto mesh = std::make_shared<TriangleMesh>(data, mat, BVHBuildMode::parallel);
+    if (write_mesh_cache(cache_path, obj_path, fit, *mesh))
+        std::clog << "Wrote mesh cache '" << cache_path << "'\n";
+    return mesh;
+}
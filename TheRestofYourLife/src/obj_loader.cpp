@@ -0,0 +1,143 @@
+#include "obj_loader.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// One corner of an OBJ face: 1-based position/texcoord/normal indices after
+// resolving negatives, 0 when the component is absent.
+struct ObjCorner {
+    long v, vt, vn;
+
+    bool operator==(const ObjCorner& other) const {
+        return v == other.v && vt == other.vt && vn == other.vn;
+    }
+};
+
+struct ObjCornerHash {
+    size_t operator()(const ObjCorner& c) const {
+        uint64_t h = uint64_t(c.v) * 0x9e3779b97f4a7c15ull;
+        h ^= uint64_t(c.vt) + 0x7f4a7c159e3779b9ull + (h << 6) + (h >> 2);
+        h ^= uint64_t(c.vn) + 0x7f4a7c159e3779b9ull + (h << 6) + (h >> 2);
+        return size_t(h);
+    }
+};
+
+long resolve_index(long index, size_t count) {
+    return index < 0 ? long(count) + index + 1 : index;
+}
+
+bool parse_corner(const std::string& token, size_t positions, size_t texcoords, size_t normals, ObjCorner& corner) {
+    corner = ObjCorner{0, 0, 0};
+    const char* s = token.c_str();
+    char* end = nullptr;
+
+    corner.v = resolve_index(std::strtol(s, &end, 10), positions);
+    if (end == s) return false;
+    if (*end == '/') {
+        s = end + 1;
+        if (*s != '/') {
+            corner.vt = resolve_index(std::strtol(s, &end, 10), texcoords);
+            if (end == s) return false;
+        } else {
+            end = const_cast<char*>(s);
+        }
+        if (*end == '/') {
+            s = end + 1;
+            corner.vn = resolve_index(std::strtol(s, &end, 10), normals);
+            if (end == s) return false;
+        }
+    }
+
+    return corner.v >= 1 && size_t(corner.v) <= positions &&
+           corner.vt >= 0 && size_t(corner.vt) <= texcoords &&
+           corner.vn >= 0 && size_t(corner.vn) <= normals;
+}
+
+} // namespace
+
+std::shared_ptr<MeshData> load_obj(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "ERROR: Could not open OBJ file '" << path << "'.\n";
+        return nullptr;
+    }
+
+    std::vector<Point3> positions;
+    std::vector<MeshTexcoord> texcoords;
+    std::vector<Vec3> normals;
+
+    auto mesh = std::make_shared<MeshData>();
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> vertex_of;
+    bool all_texcoords = true;
+    bool all_normals = true;
+
+    std::string line;
+    std::vector<uint32_t> face;
+    for (int line_number = 1; std::getline(in, line); line_number++) {
+        std::istringstream fields(line);
+        std::string tag;
+        if (!(fields >> tag) || tag[0] == '#')
+            continue;
+
+        if (tag == "v") {
+            Point3 p;
+            fields >> p.x >> p.y >> p.z;
+            positions.push_back(p);
+        } else if (tag == "vt") {
+            MeshTexcoord t{0, 0};
+            fields >> t.u >> t.v;
+            texcoords.push_back(t);
+        } else if (tag == "vn") {
+            Vec3 n;
+            fields >> n.x >> n.y >> n.z;
+            normals.push_back(n);
+        } else if (tag == "f") {
+            face.clear();
+            std::string token;
+            while (fields >> token) {
+                ObjCorner corner;
+                if (!parse_corner(token, positions.size(), texcoords.size(), normals.size(), corner)) {
+                    std::cerr << "ERROR: Bad face vertex '" << token << "' in '" << path
+                              << "' line " << line_number << ".\n";
+                    return nullptr;
+                }
+
+                auto found = vertex_of.find(corner);
+                if (found == vertex_of.end()) {
+                    uint32_t index = uint32_t(mesh->positions.size());
+                    mesh->positions.push_back(positions[corner.v - 1]);
+                    mesh->texcoords.push_back(corner.vt ? texcoords[corner.vt - 1] : MeshTexcoord{0, 0});
+                    mesh->normals.push_back(corner.vn ? normals[corner.vn - 1] : Vec3(0, 0, 0));
+                    all_texcoords = all_texcoords && corner.vt;
+                    all_normals = all_normals && corner.vn;
+                    found = vertex_of.emplace(corner, index).first;
+                }
+                face.push_back(found->second);
+            }
+
+            for (size_t k = 2; k < face.size(); k++) {
+                mesh->indices.push_back(face[0]);
+                mesh->indices.push_back(face[k - 1]);
+                mesh->indices.push_back(face[k]);
+            }
+        }
+    }
+
+    // Partial attributes can't be interpolated; fall back to geometric
+    // normals and barycentric UVs for the whole mesh.
+    if (!all_texcoords) mesh->texcoords.clear();
+    if (!all_normals) mesh->normals.clear();
+
+    if (mesh->indices.empty()) {
+        std::cerr << "ERROR: OBJ file '" << path << "' has no faces.\n";
+        return nullptr;
+    }
+    return mesh;
+}
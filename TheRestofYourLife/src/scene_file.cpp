@@ -0,0 +1,502 @@
+#include "scene_file.h"
+#include "material.h"
+#include "texture.h"
+#include "bvh.h"
+#include "quad.h"
+#include "transform.h"
+#include "constant_medium.h"
+#include "mesh_cache.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Splits a stream into words, quoted strings and braces, skipping whitespace
+// and '#' comments. Reads one character at a time, so blocks are built while
+// the file is still being read.
+class SceneTokenizer {
+  public:
+    explicit SceneTokenizer(std::istream& in) : in(in) {}
+
+    // Returns false at the end of the input (or on an unterminated string,
+    // reported through `unterminated`).
+    bool next(std::string& token, bool& quoted) {
+        token.clear();
+        quoted = false;
+        int c = skip_space();
+        if (c == EOF)
+            return false;
+        token_line = line_number;
+
+        if (c == '{' || c == '}') {
+            token.push_back(char(c));
+            return true;
+        }
+        if (c == '"') {
+            quoted = true;
+            while ((c = in.get()) != EOF && c != '"' && c != '\n')
+                token.push_back(char(c));
+            if (c != '"') {
+                unterminated = true;
+                return false;
+            }
+            return true;
+        }
+        while (c != EOF && !std::isspace(c) && c != '{' && c != '}' && c != '#' && c != '"') {
+            token.push_back(char(c));
+            c = in.get();
+        }
+        if (c != EOF)
+            in.unget();
+        return true;
+    }
+
+    int line() const { return token_line; }
+    bool unterminated = false;
+
+  private:
+    int skip_space() {
+        for (int c = in.get(); c != EOF; c = in.get()) {
+            if (c == '#') {
+                while ((c = in.get()) != EOF && c != '\n') {}
+            }
+            if (c == '\n')
+                line_number++;
+            else if (c != EOF && !std::isspace(c))
+                return c;
+            if (c == EOF)
+                break;
+        }
+        return EOF;
+    }
+
+    std::istream& in;
+    int line_number = 1;
+    int token_line = 1;
+};
+
+struct SceneProperty {
+    std::string key;
+    std::vector<std::string> values;
+    int line;
+};
+
+// One "header words { key: values ... }" entry.
+struct SceneBlock {
+    std::vector<std::string> header;
+    std::vector<SceneProperty> properties;
+    int line = 0;
+};
+
+class SceneReader {
+  public:
+    SceneReader(const std::string& path, double aspect_ratio, Scene& scene)
+        : path(path), aspect_ratio(aspect_ratio), scene(scene) {}
+
+    bool read(std::istream& in) {
+        SceneTokenizer tokens(in);
+        SceneBlock block;
+        bool done = false;
+        while (read_block(tokens, block, done)) {
+            if (done)
+                return finish();
+            if (!add_block(block))
+                return false;
+        }
+        return false;
+    }
+
+  private:
+    bool fail(int line, const std::string& message) const {
+        std::cerr << "ERROR: " << path << ':' << line << ": " << message << '\n';
+        return false;
+    }
+
+    static bool is_key(const std::string& token, bool quoted) {
+        return !quoted && token.size() > 1 && token.back() == ':';
+    }
+
+    bool read_block(SceneTokenizer& tokens, SceneBlock& block, bool& done) {
+        block = SceneBlock();
+        std::string token;
+        bool quoted;
+
+        while (tokens.next(token, quoted)) {
+            if (block.header.empty())
+                block.line = tokens.line();
+            if (!quoted && token == "{")
+                break;
+            if ((!quoted && token == "}") || is_key(token, quoted))
+                return fail(tokens.line(), "expected a block name before '" + token + "'");
+            block.header.push_back(token);
+        }
+        if (tokens.unterminated)
+            return fail(tokens.line(), "unterminated string");
+        if (block.header.empty() && token != "{") {
+            done = true;
+            return true;
+        }
+        if (token != "{")
+            return fail(block.line, "expected '{' after '" + block.header.back() + "'");
+        if (block.header.empty())
+            return fail(block.line, "block without a name");
+
+        while (tokens.next(token, quoted)) {
+            if (!quoted && token == "}")
+                return true;
+            if (!quoted && token == "{")
+                return fail(tokens.line(), "blocks cannot be nested");
+            if (is_key(token, quoted)) {
+                token.pop_back();
+                block.properties.push_back(SceneProperty{ token, {}, tokens.line() });
+            } else if (block.properties.empty()) {
+                return fail(tokens.line(), "value '" + token + "' without a key");
+            } else {
+                block.properties.back().values.push_back(token);
+            }
+        }
+        if (tokens.unterminated)
+            return fail(tokens.line(), "unterminated string");
+        return fail(block.line, "missing '}' for '" + block.header[0] + "'");
+    }
+
+    bool check_keys(const SceneBlock& block, std::initializer_list<const char*> keys) const {
+        for (const SceneProperty& property : block.properties) {
+            bool known = false;
+            for (const char* key : keys)
+                known = known || property.key == key;
+            if (!known)
+                return fail(property.line, "unknown key '" + property.key + "' in '" + block.header[0] + "'");
+        }
+        return true;
+    }
+
+    const SceneProperty* find(const SceneBlock& block, const char* key) const {
+        const SceneProperty* found = nullptr;
+        for (const SceneProperty& property : block.properties)
+            if (property.key == key) found = &property;
+        return found;
+    }
+
+    bool missing(const SceneBlock& block, const char* key) const {
+        return fail(block.line, "'" + block.header[0] + "' needs '" + key + ":'");
+    }
+
+    bool parse_numbers(const SceneProperty& property, double* values, size_t count) const {
+        if (property.values.size() != count)
+            return fail(property.line, "'" + property.key + "' takes " + std::to_string(count) + " number(s)");
+        for (size_t k = 0; k < count; k++) {
+            const char* text = property.values[k].c_str();
+            char* end = nullptr;
+            values[k] = std::strtod(text, &end);
+            if (end == text || *end != '\0')
+                return fail(property.line, "'" + property.values[k] + "' is not a number");
+        }
+        return true;
+    }
+
+    bool get_number(const SceneBlock& block, const char* key, double& value, bool required = true) const {
+        const SceneProperty* property = find(block, key);
+        if (!property)
+            return !required || missing(block, key);
+        return parse_numbers(*property, &value, 1);
+    }
+
+    bool get_vec3(const SceneBlock& block, const char* key, Vec3& value, bool required = true) const {
+        const SceneProperty* property = find(block, key);
+        if (!property)
+            return !required || missing(block, key);
+        double xyz[3];
+        if (!parse_numbers(*property, xyz, 3))
+            return false;
+        value = Vec3(xyz[0], xyz[1], xyz[2]);
+        return true;
+    }
+
+    bool get_string(const SceneBlock& block, const char* key, std::string& value) const {
+        const SceneProperty* property = find(block, key);
+        if (!property)
+            return missing(block, key);
+        if (property->values.size() != 1)
+            return fail(property->line, "'" + std::string(key) + "' takes one name");
+        value = property->values[0];
+        return true;
+    }
+
+    // A color (three numbers) or the name of a texture defined earlier.
+    bool get_texture(const SceneBlock& block, const char* key, std::shared_ptr<RTTexture>& tex) const {
+        const SceneProperty* property = find(block, key);
+        if (!property)
+            return missing(block, key);
+        if (property->values.size() == 1) {
+            auto found = textures.find(property->values[0]);
+            if (found == textures.end())
+                return fail(property->line, "unknown texture '" + property->values[0] + "'");
+            tex = found->second;
+            return true;
+        }
+        double rgb[3];
+        if (!parse_numbers(*property, rgb, 3))
+            return false;
+        tex = std::make_shared<SolidColor>(Color3(rgb[0], rgb[1], rgb[2]));
+        return true;
+    }
+
+    std::string resolve_path(const std::string& file) const {
+        std::filesystem::path relative(file);
+        if (relative.is_absolute())
+            return file;
+        return (std::filesystem::path(path).parent_path() / relative).string();
+    }
+
+    bool add_block(const SceneBlock& block) {
+        const std::string& kind = block.header[0];
+        if (kind == "camera")
+            return block.header.size() == 1 ? set_camera(block) : fail(block.line, "usage: camera { ... }");
+        if (kind == "texture" || kind == "material") {
+            if (block.header.size() != 3)
+                return fail(block.line, "usage: " + kind + " NAME TYPE { ... }");
+            if (textures.count(block.header[1]) || materials.count(block.header[1]))
+                return fail(block.line, "'" + block.header[1] + "' is already defined");
+            return kind == "texture" ? add_texture(block) : add_material(block);
+        }
+        if (kind == "sphere" || kind == "quad" || kind == "box" || kind == "mesh")
+            return block.header.size() == 1 ? add_shape(block) : fail(block.line, "usage: " + kind + " { ... }");
+        return fail(block.line, "unknown block '" + kind + "'");
+    }
+
+    bool set_camera(const SceneBlock& block) {
+        if (!check_keys(block, { "from", "at", "up", "vfov", "aperture", "focus_dist" }))
+            return false;
+        Point3 from, at;
+        Vec3 up(0, 1, 0);
+        double vfov = 40.0, aperture = 0.0, focus_dist = 10.0;
+        if (!get_vec3(block, "from", from) || !get_vec3(block, "at", at) || !get_vec3(block, "up", up, false) ||
+            !get_number(block, "vfov", vfov, false) || !get_number(block, "aperture", aperture, false) ||
+            !get_number(block, "focus_dist", focus_dist, false))
+            return false;
+        scene.camera = RTCamera(from, at, up, vfov, aspect_ratio, aperture, focus_dist, 0.0, 1.0);
+        has_camera = true;
+        return true;
+    }
+
+    bool add_texture(const SceneBlock& block) {
+        const std::string& type = block.header[2];
+        std::shared_ptr<RTTexture> tex;
+        if (type == "solid") {
+            Vec3 color;
+            if (!check_keys(block, { "color" }) || !get_vec3(block, "color", color))
+                return false;
+            tex = std::make_shared<SolidColor>(color);
+        } else if (type == "checker") {
+            double scale;
+            std::shared_ptr<RTTexture> even, odd;
+            if (!check_keys(block, { "scale", "even", "odd" }) || !get_number(block, "scale", scale) ||
+                !get_texture(block, "even", even) || !get_texture(block, "odd", odd))
+                return false;
+            tex = std::make_shared<CheckerTexture>(scale, even, odd);
+        } else if (type == "noise") {
+            double scale;
+            if (!check_keys(block, { "scale" }) || !get_number(block, "scale", scale))
+                return false;
+            tex = std::make_shared<NoiseTexture>(scale);
+        } else if (type == "image") {
+            std::string file;
+            if (!check_keys(block, { "file" }) || !get_string(block, "file", file))
+                return false;
+            tex = std::make_shared<ImageTexture>(resolve_path(file).c_str());
+        } else {
+            return fail(block.line, "unknown texture type '" + type + "' (solid, checker, noise, image)");
+        }
+        textures[block.header[1]] = tex;
+        return true;
+    }
+
+    bool add_material(const SceneBlock& block) {
+        const std::string& type = block.header[2];
+        std::shared_ptr<RTMaterial> mat;
+        std::shared_ptr<RTTexture> tex;
+        if (type == "lambertian") {
+            if (!check_keys(block, { "albedo" }) || !get_texture(block, "albedo", tex))
+                return false;
+            mat = std::make_shared<Lambertian>(tex);
+        } else if (type == "metal") {
+            Vec3 albedo;
+            double fuzz = 0.0;
+            if (!check_keys(block, { "albedo", "fuzz" }) || !get_vec3(block, "albedo", albedo) ||
+                !get_number(block, "fuzz", fuzz, false))
+                return false;
+            mat = std::make_shared<Metal>(albedo, fuzz);
+        } else if (type == "dielectric") {
+            double ior;
+            if (!check_keys(block, { "ior" }) || !get_number(block, "ior", ior))
+                return false;
+            mat = std::make_shared<Dielectric>(ior);
+        } else if (type == "light") {
+            if (!check_keys(block, { "emit" }) || !get_texture(block, "emit", tex))
+                return false;
+            mat = std::make_shared<DiffuseLight>(tex);
+        } else if (type == "isotropic") {
+            if (!check_keys(block, { "albedo" }) || !get_texture(block, "albedo", tex))
+                return false;
+            mat = std::make_shared<Isotropic>(tex);
+        } else {
+            return fail(block.line,
+                        "unknown material type '" + type + "' (lambertian, metal, dielectric, light, isotropic)");
+        }
+        materials[block.header[1]] = mat;
+        return true;
+    }
+
+    bool add_shape(const SceneBlock& block) {
+        const std::string& kind = block.header[0];
+        bool is_medium = find(block, "medium") != nullptr;
+
+        // The integrator aims light samples with pdf_value() and random(),
+        // which meshes and media don't provide.
+        if (const SceneProperty* light = find(block, "light")) {
+            if (kind == "mesh")
+                return fail(light->line, "a mesh cannot be a light");
+            if (is_medium)
+                return fail(light->line, "a medium cannot be a light");
+        }
+
+        std::shared_ptr<RTMaterial> mat;
+        if (find(block, "material") || !is_medium) {
+            std::string name;
+            if (!get_string(block, "material", name))
+                return false;
+            auto found = materials.find(name);
+            if (found == materials.end())
+                return fail(find(block, "material")->line, "unknown material '" + name + "'");
+            mat = found->second;
+        }
+
+        std::shared_ptr<Hittable> shape;
+        if (kind == "sphere") {
+            Point3 center, center2;
+            double radius;
+            if (!check_keys(block, { "center", "center2", "radius", "material", "rotate_y", "translate",
+                                     "medium", "medium_albedo", "light" }) ||
+                !get_vec3(block, "center", center) || !get_number(block, "radius", radius))
+                return false;
+            if (find(block, "center2")) {
+                if (!get_vec3(block, "center2", center2))
+                    return false;
+                shape = std::make_shared<Sphere>(center, center2, radius, mat);
+            } else {
+                shape = std::make_shared<Sphere>(center, radius, mat);
+            }
+        } else if (kind == "quad") {
+            Point3 q;
+            Vec3 u, v;
+            if (!check_keys(block, { "q", "u", "v", "material", "rotate_y", "translate",
+                                     "medium", "medium_albedo", "light" }) ||
+                !get_vec3(block, "q", q) || !get_vec3(block, "u", u) || !get_vec3(block, "v", v))
+                return false;
+            shape = std::make_shared<Quad>(q, u, v, mat);
+        } else if (kind == "box") {
+            Point3 a, b;
+            if (!check_keys(block, { "min", "max", "material", "rotate_y", "translate",
+                                     "medium", "medium_albedo", "light" }) ||
+                !get_vec3(block, "min", a) || !get_vec3(block, "max", b))
+                return false;
+            shape = box(a, b, mat);
+        } else {
+            std::string file;
+            if (!check_keys(block, { "file", "fit", "material", "rotate_y", "translate",
+                                     "medium", "medium_albedo", "light" }) ||
+                !get_string(block, "file", file))
+                return false;
+            AABB fit;
+            if (const SceneProperty* property = find(block, "fit")) {
+                double corners[6];
+                if (!parse_numbers(*property, corners, 6))
+                    return false;
+                fit = AABB(Point3(corners[0], corners[1], corners[2]), Point3(corners[3], corners[4], corners[5]));
+            }
+            auto mesh = load_obj_cached(resolve_path(file), mat, fit);
+            if (!mesh)
+                return fail(block.line, "could not load mesh '" + file + "'");
+            shape = mesh;
+        }
+
+        for (const SceneProperty& property : block.properties) {
+            if (property.key == "rotate_y") {
+                double angle;
+                if (!parse_numbers(property, &angle, 1))
+                    return false;
+                shape = std::make_shared<RotateY>(shape, angle);
+            } else if (property.key == "translate") {
+                double offset[3];
+                if (!parse_numbers(property, offset, 3))
+                    return false;
+                shape = std::make_shared<Translate>(shape, Vec3(offset[0], offset[1], offset[2]));
+            } else if (property.key == "light" && !property.values.empty()) {
+                return fail(property.line, "'light' takes no value");
+            }
+        }
+
+        if (is_medium) {
+            double density;
+            std::shared_ptr<RTTexture> albedo;
+            if (!get_number(block, "medium", density) || !get_texture(block, "medium_albedo", albedo))
+                return false;
+            shape = std::make_shared<ConstantMedium>(shape, density, albedo);
+        }
+
+        objects.add(shape);
+        if (find(block, "light"))
+            scene.lights.add(shape);
+        return true;
+    }
+
+    bool finish() {
+        if (!has_camera)
+            return fail(1, "no camera block");
+        if (objects.objects.empty())
+            return fail(1, "the scene has no shapes");
+        if (scene.lights.objects.empty())
+            return fail(1, "the scene has no lights (mark at least one shape with 'light:')");
+        scene.world = HittableList(std::make_shared<BVHNode>(objects, BVHBuildMode::parallel));
+        return true;
+    }
+
+    std::string path;
+    double aspect_ratio;
+    Scene& scene;
+    HittableList objects;
+    bool has_camera = false;
+    std::map<std::string, std::shared_ptr<RTTexture>> textures;
+    std::map<std::string, std::shared_ptr<RTMaterial>> materials;
+};
+
+} // namespace
+
+bool is_scene_file(const std::string& name) {
+    const std::string extension = ".scene";
+    return name.size() > extension.size() &&
+           name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool load_scene_file(const std::string& path, double aspect_ratio, Scene& scene) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "ERROR: Could not open scene file '" << path << "'.\n";
+        return false;
+    }
+    Scene loaded;
+    if (!SceneReader(path, aspect_ratio, loaded).read(in))
+        return false;
+    scene = loaded;
+    return true;
+}
@@ -0,0 +1,99 @@
+#include "scenes.h"
+#include "scene_file.h"
+#include "material.h"
+#include "quad.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+
+#include <cmath>
+#include <iostream>
+
+std::shared_ptr<HittableList> box(const Point3& a, const Point3& b, std::shared_ptr<RTMaterial> mat) {
+    auto sides = std::make_shared<HittableList>();
+    auto min = Point3(std::fmin(a.x, b.x), std::fmin(a.y, b.y), std::fmin(a.z, b.z));
+    auto max = Point3(std::fmax(a.x, b.x), std::fmax(a.y, b.y), std::fmax(a.z, b.z));
+    Vec3 dx = Vec3(max.x - min.x, 0, 0);
+    Vec3 dy = Vec3(0, max.y - min.y, 0);
+    Vec3 dz = Vec3(0, 0, max.z - min.z);
+    sides->add(std::make_shared<Quad>(Point3(min.x, min.y, max.z),  dx,  dy, mat)); 
+    sides->add(std::make_shared<Quad>(Point3(max.x, min.y, max.z), -dz,  dy, mat)); 
+    sides->add(std::make_shared<Quad>(Point3(max.x, min.y, min.z), -dx,  dy, mat)); 
+    sides->add(std::make_shared<Quad>(Point3(min.x, min.y, min.z),  dz,  dy, mat)); 
+    sides->add(std::make_shared<Quad>(Point3(min.x, max.y, max.z),  dx, -dz, mat)); 
+    sides->add(std::make_shared<Quad>(Point3(min.x, min.y, min.z),  dx,  dz, mat)); 
+    return sides;
+}
+
+Scene cornell_room(double aspect_ratio) {
+    Scene scene;
+    HittableList& world = scene.world;
+
+    auto red   = std::make_shared<Lambertian>(Color3(.65, .05, .05));
+    auto white = std::make_shared<Lambertian>(Color3(.73, .73, .73));
+    auto green = std::make_shared<Lambertian>(Color3(.12, .45, .15));
+    auto light = std::make_shared<DiffuseLight>(Color3(15, 15, 15));
+
+    world.add(std::make_shared<Quad>(Point3(555,0,0), Vec3(0,555,0), Vec3(0,0,555), green));
+    world.add(std::make_shared<Quad>(Point3(0,0,0), Vec3(0,555,0), Vec3(0,0,555), red));
+    world.add(std::make_shared<Quad>(Point3(343, 554, 332), Vec3(-130,0,0), Vec3(0,0,-105), light)); // Лампа
+    world.add(std::make_shared<Quad>(Point3(0,0,0), Vec3(555,0,0), Vec3(0,0,555), white)); // Пол
+    world.add(std::make_shared<Quad>(Point3(555,555,555), Vec3(-555,0,0), Vec3(0,0,-555), white)); // Потолок
+    world.add(std::make_shared<Quad>(Point3(0,0,555), Vec3(555,0,0), Vec3(0,555,0), white)); // Задняя стена
+
+    scene.lights.add(std::make_shared<Quad>(Point3(343, 554, 332), Vec3(-130,0,0), Vec3(0,0,-105), light));
+
+    scene.camera = RTCamera(
+        Point3(278, 278, -800),
+        Point3(278, 278, 0),
+        Vec3(0, 1, 0),
+        40.0,
+        aspect_ratio,
+        0.0,
+        10.0
+    );
+
+    return scene;
+}
+
+Scene cornell_box(double aspect_ratio) {
+    Scene scene = cornell_room(aspect_ratio);
+    HittableList& world = scene.world;
+
+    auto white = std::make_shared<Lambertian>(Color3(.73, .73, .73));
+    auto aluminum = std::make_shared<Metal>(Color3(0.8, 0.85, 0.88), 0.5);
+    auto glass    = std::make_shared<Dielectric>(1.5);
+
+    std::shared_ptr<Hittable> box1 = box(Point3(130, 0, 65), Point3(295, 165, 230), white); // Обычный белый куб
+    
+    world.add(std::make_shared<Sphere>(Point3(190, 90, 190), 90, glass));
+
+    std::shared_ptr<Hittable> box2 = box(Point3(265, 0, 295), Point3(430, 330, 460), aluminum);
+    world.add(box2);
+
+    return scene;
+}
+
+bool cornell_mesh(const std::string& obj_path, double aspect_ratio, Scene& scene) {
+    auto white = std::make_shared<Lambertian>(Color3(.73, .73, .73));
+    auto triangles = load_obj_cached(obj_path, white, AABB(Point3(130, 0, 130), Point3(425, 400, 425)));
+    if (!triangles)
+        return false;
+    std::clog << "BVH (" << obj_path << "): " << triangles->build_stats() << '\n';
+
+    scene = cornell_room(aspect_ratio);
+    scene.world.add(triangles);
+    return true;
+}
+
+bool make_scene(const std::string& name, double aspect_ratio, Scene& scene) {
+    if (name.empty() || name == "cornell") {
+        scene = cornell_box(aspect_ratio);
+        return true;
+    }
+    if (is_scene_file(name))
+        return load_scene_file(name, aspect_ratio, scene);
+    if (name.compare(0, 4, "obj:") == 0)
+        return cornell_mesh(name.substr(4), aspect_ratio, scene);
+    std::cerr << "ERROR: Unknown scene '" << name << "' (available: cornell, obj:<file.obj>, or a .scene file).\n";
+    return false;
+}
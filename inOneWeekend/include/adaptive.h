@@ -0,0 +1,142 @@
+#ifndef RT_ADAPTIVE_H
+#define RT_ADAPTIVE_H
+
+#include "raylib.h"
+
+#include "headless.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Accumulation buffer and adaptive sampler of the progressive viewers. Each
+// pixel keeps the sum of its samples, the sum of their squared luminance and
+// the sample count, which gives the standard error of the pixel's mean.
+// Measured in display units (after the gamma-2 curve the viewers apply), that
+// error decides how many samples the pixel takes next frame: none once it is
+// below `threshold`, and up to max_factor times the frame's base count the
+// further above it is.
+class AdaptiveSampler {
+public:
+    bool enabled = true;
+    double threshold = 0.01;
+    int max_factor = 4;
+    // Below this count a pixel is always sampled: until a rare bright path
+    // (a caustic, a small light seen by reflection) turns up, its variance
+    // looks like zero.
+    int min_samples = 16;
+
+    struct Summary {
+        double mean_samples = 0;   // per pixel
+        int max_samples = 0;
+        double active = 0;         // fraction of pixels still being sampled
+    };
+
+    AdaptiveSampler(int width, int height) : width(width), height(height), pixels(size_t(width) * height) {}
+
+    void reset() {
+        std::fill(pixels.begin(), pixels.end(), PixelStats());
+    }
+
+    // Samples pixel `index` should take in a frame that gives every pixel `base`.
+    int samples_for(int index, int base) const {
+        const PixelStats& px = pixels[index];
+        if (!enabled || px.samples < min_samples)
+            return base;
+        double ratio = error(index) / threshold;
+        if (ratio < 1)
+            return 0;
+        return base * (ratio < max_factor ? int(ratio) : max_factor);
+    }
+
+    // Adds one sample. NaN and infinite samples are dropped: one of them
+    // would stay in the pixel's sums for good.
+    void add(int index, const Color3& sample) {
+        double y = luminance(sample);
+        if (!std::isfinite(y))
+            return;
+        PixelStats& px = pixels[index];
+        px.sum += sample;
+        px.sum_sq += y * y;
+        px.samples++;
+    }
+
+    int samples(int index) const {
+        return pixels[index].samples;
+    }
+
+    Color3 mean(int index) const {
+        const PixelStats& px = pixels[index];
+        return px.samples > 0 ? resolve_pixel(px.sum, px.samples) : Color3(0, 0, 0);
+    }
+
+    // Standard error of the pixel's displayed value: the standard error of
+    // its mean luminance times the slope of sqrt() there.
+    double error(int index) const {
+        const PixelStats& px = pixels[index];
+        if (px.samples < 2)
+            return std::numeric_limits<double>::infinity();
+        double n = px.samples;
+        double mean = luminance(px.sum) / n;
+        double variance = std::fmax(0.0, (px.sum_sq - mean * mean * n) / (n - 1));
+        return std::sqrt(variance / n) / (2 * std::sqrt(std::fmax(mean, 1e-3)));
+    }
+
+    Summary summary(int base) const {
+        Summary s;
+        double total = 0;
+        int active = 0;
+        for (int index = 0; index < int(pixels.size()); index++) {
+            total += pixels[index].samples;
+            s.max_samples = std::max(s.max_samples, pixels[index].samples);
+            active += samples_for(index, base) > 0;
+        }
+        if (!pixels.empty()) {
+            s.mean_samples = total / pixels.size();
+            s.active = double(active) / pixels.size();
+        }
+        return s;
+    }
+
+    // Writes the pixel means into `image` (RGBA8, width x height) or, with
+    // `density`, the sample count of each pixel relative to the most sampled
+    // one, from blue (few) through green to red (most).
+    void to_image(Image& image, bool density) const {
+        Color* out = (Color*)image.data;
+        int most = 1;
+        if (density)
+            for (const PixelStats& px : pixels)
+                most = std::max(most, px.samples);
+
+        for (int index = 0; index < width * height; index++) {
+            if (density) {
+                double t = double(pixels[index].samples) / most;
+                double r = std::fmax(0.0, 2 * t - 1);
+                double b = std::fmax(0.0, 1 - 2 * t);
+                out[index] = Color{ (unsigned char)(255 * r), (unsigned char)(255 * (1 - r - b)),
+                                    (unsigned char)(255 * b), 255 };
+            } else {
+                Color3 col = mean(index);
+                out[index] = Color{ gamma_byte(col.x), gamma_byte(col.y), gamma_byte(col.z), 255 };
+            }
+        }
+    }
+
+private:
+    struct PixelStats {
+        Color3 sum = Color3(0, 0, 0);
+        double sum_sq = 0;
+        int samples = 0;
+    };
+
+    int width, height;
+    std::vector<PixelStats> pixels;
+
+    static double luminance(const Color3& c) {
+        return 0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z;
+    }
+};
+
+#endif
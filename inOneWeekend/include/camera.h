@@ -14,35 +14,35 @@ public:
     Point3 position;
     Point3 look_at;
     Vec3 vup;
-    double vfov;
-    double aspect_ratio;
-    double aperture;
-    double focus_dist;
+    real vfov;
+    real aspect_ratio;
+    real aperture;
+    real focus_dist;
 
     Point3 origin;
     Vec3 horizontal;
     Vec3 vertical;
     Point3 lower_left_corner;
     Vec3 u, v, w;
-    double lens_radius;
+    real lens_radius;
 
     RTCamera(Point3 position = Point3(0, 0, 0),
            Point3 look_at = Point3(0, 0, -1),
            Vec3 vup = Vec3(0, 1, 0),
-           double vfov = 90.0,
-           double aspect_ratio = 16.0 / 9.0,
-           double aperture = 0.0,
-           double focus_dist = 1.0)
+           real vfov = 90.0,
+           real aspect_ratio = 16.0 / 9.0,
+           real aperture = 0.0,
+           real focus_dist = 1.0)
         : position(position), look_at(look_at), vup(vup), vfov(vfov),
           aspect_ratio(aspect_ratio), aperture(aperture), focus_dist(focus_dist) {
         update();
     }
 
     void update() {
-        double theta = vfov * M_PI / 180.0;
-        double h = std::tan(theta / 2.0);
-        double viewport_height = 2.0 * h;
-        double viewport_width = aspect_ratio * viewport_height;
+        real theta = vfov * M_PI / 180.0;
+        real h = std::tan(theta / 2.0);
+        real viewport_height = 2.0 * h;
+        real viewport_width = aspect_ratio * viewport_height;
 
         w = unit_vector(position - look_at);
         u = unit_vector(cross(vup, w));
@@ -56,7 +56,7 @@ public:
         lens_radius = aperture / 2.0;
     }
 
-    RTRay get_ray(double s, double t) const {
+    RTRay get_ray(real s, real t) const {
         Vec3 rd = lens_radius * random_in_unit_disk();
         Vec3 offset = u * rd.x + v * rd.y;
 
@@ -64,36 +64,36 @@ public:
                    lower_left_corner + s * horizontal + t * vertical - origin - offset);
     }
 
-    void move_forward(double speed) {
+    void move_forward(real speed) {
         Vec3 forward = unit_vector(look_at - position);
         position += forward * speed;
         look_at += forward * speed;
         update();
     }
 
-    void move_right(double speed) {
+    void move_right(real speed) {
         position += u * speed;
         look_at += u * speed;
         update();
     }
 
-    void move_up(double speed) {
+    void move_up(real speed) {
         position += vup * speed;
         look_at += vup * speed;
         update();
     }
 
-    void rotate(double yaw, double pitch) {
+    void rotate(real yaw, real pitch) {
         Vec3 direction = look_at - position;
-        double distance = direction.length();
+        real distance = direction.length();
 
-        double current_pitch = std::asin(direction.y / distance);
-        double current_yaw = std::atan2(direction.z, direction.x);
+        real current_pitch = std::asin(direction.y / distance);
+        real current_yaw = std::atan2(direction.z, direction.x);
 
         current_yaw += yaw;
         current_pitch += pitch;
 
-        const double max_pitch = M_PI / 2.0 - 0.01;
+        const real max_pitch = M_PI / 2.0 - 0.01;
         if (current_pitch > max_pitch) current_pitch = max_pitch;
         if (current_pitch < -max_pitch) current_pitch = -max_pitch;
 
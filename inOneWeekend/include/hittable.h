@@ -12,8 +12,8 @@ class RTMaterial;
 struct HitRecord {
     Point3 p;
     Vec3 normal;
-    std::shared_ptr<RTMaterial> mat;
-    double t;
+    const RTMaterial* mat;
+    real t;
     bool front_face;
 
     void set_face_normal(const RTRay& r, const Vec3& outward_normal) {
@@ -58,7 +58,7 @@ public:
         rec.p = r.at(rec.t);
         Vec3 outward_normal = (rec.p - center) / radius;
         rec.set_face_normal(r, outward_normal);
-        rec.mat = mat;
+        rec.mat = mat.get();
 
         return true;
     }
@@ -75,15 +75,13 @@ public:
     void add(std::shared_ptr<Hittable> object) { objects.push_back(object); }
 
     virtual bool hit(const RTRay& r, double t_min, double t_max, HitRecord& rec) const override {
-        HitRecord temp_rec;
         bool hit_anything = false;
         double closest_so_far = t_max;
 
         for (const auto& object : objects) {
-            if (object->hit(r, t_min, closest_so_far, temp_rec)) {
+            if (object->hit(r, t_min, closest_so_far, rec)) {
                 hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
+                closest_so_far = rec.t;
             }
         }
 
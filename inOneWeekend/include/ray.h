@@ -12,7 +12,7 @@ public:
     RTRay(const Point3& origin, const Vec3& direction)
         : origin(origin), direction(direction) {}
 
-    Point3 at(double t) const {
+    Point3 at(real t) const {
         return origin + t * direction;
     }
 };
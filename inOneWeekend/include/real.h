@@ -0,0 +1,14 @@
+#ifndef RT_REAL_H
+#define RT_REAL_H
+
+// Scalar type of the core geometry: Vec3, interval, AABB, RTRay, HitRecord
+// and the camera. Double by default; configure with -DRT_SCALAR=float for a
+// build with half-size vectors, rays and hit records. Keep double for scenes
+// with large coordinates, such as Book 2's 5000-radius fog sphere.
+#ifndef RT_SCALAR
+#define RT_SCALAR double
+#endif
+
+using real = RT_SCALAR;
+
+#endif
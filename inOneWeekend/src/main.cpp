@@ -4,11 +4,29 @@
 #include "../include/camera.h"
 #include "../include/hittable.h"
 #include "../include/material.h"
+#include "../include/scheduler.h"
+#include "../include/headless.h"
+#include "../include/adaptive.h"
 #include <memory>
 #include <vector>
+#include <iostream>
 #include <cmath>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <string>
+
+// Paths stop being forced to continue after this many bounces; from then on
+// each bounce survives with probability equal to the brightest throughput
+// channel and the survivors are reweighted, so the estimate stays unbiased.
+const int roulette_min_bounces = 3;
+
+inline bool russian_roulette(Color3& throughput) {
+    double survive = std::fmin(std::fmax(throughput.x, std::fmax(throughput.y, throughput.z)), 0.95);
+    if (random_double() >= survive)
+        return false;
+    throughput = throughput / survive;
+    return true;
+}
 
 bool Lambertian::scatter(const RTRay& r_in, const HitRecord& rec, Color3& attenuation, RTRay& scattered) const {
     (void)r_in;
@@ -38,7 +56,7 @@ bool Dielectric::scatter(const RTRay& r_in, const HitRecord& rec, Color3& attenu
     bool cannot_refract = refraction_ratio * sin_theta > 1.0;
     Vec3 direction;
 
-    if (cannot_refract || reflectance(cos_theta, refraction_ratio) > ((double)rand() / RAND_MAX))
+    if (cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double())
         direction = reflect(unit_direction, rec.normal);
     else
         direction = refract(unit_direction, rec.normal, refraction_ratio);
@@ -48,21 +66,30 @@ bool Dielectric::scatter(const RTRay& r_in, const HitRecord& rec, Color3& attenu
 }
 
     Color3 ray_color(const RTRay& r, const HittableList& world, int depth) {
-    if (depth <= 0)
-        return Color3(0, 0, 0);
+    Color3 throughput(1.0, 1.0, 1.0);
+    RTRay ray = r;
+
+    for (int bounce = 0; bounce < depth; bounce++) {
+        HitRecord rec;
+        if (!world.hit(ray, 0.001, INFINITY, rec)) {
+            Vec3 unit_direction = unit_vector(ray.direction);
+            double t = 0.5 * (unit_direction.y + 1.0);
+            return throughput * ((1.0 - t) * Color3(1.0, 1.0, 1.0) + t * Color3(0.5, 0.7, 1.0));
+        }
 
-    HitRecord rec;
-    if (world.hit(r, 0.001, INFINITY, rec)) {
         RTRay scattered;
         Color3 attenuation;
-        if (rec.mat->scatter(r, rec, attenuation, scattered))
-            return attenuation * ray_color(scattered, world, depth - 1);
-        return Color3(0, 0, 0);
+        if (!rec.mat->scatter(ray, rec, attenuation, scattered))
+            break;
+
+        throughput = throughput * attenuation;
+        ray = scattered;
+
+        if (bounce + 1 >= roulette_min_bounces && !russian_roulette(throughput))
+            break;
     }
 
-    Vec3 unit_direction = unit_vector(r.direction);
-    double t = 0.5 * (unit_direction.y + 1.0);
-    return (1.0 - t) * Color3(1.0, 1.0, 1.0) + t * Color3(0.5, 0.7, 1.0);
+    return Color3(0, 0, 0);
 }
 
     HittableList create_scene() {
@@ -83,42 +110,22 @@ bool Dielectric::scatter(const RTRay& r_in, const HitRecord& rec, Color3& attenu
         return world;
 }
 
-    void buffer_to_image(Image& image, const std::vector<Color3>& buffer, int width, int height, int accumulated_samples) {
-        double scale = 1.0 / accumulated_samples;
-        unsigned char* pixels = (unsigned char*)image.data;
-        
-        for (int j = 0; j < height; j++) {
-            for (int i = 0; i < width; i++) {
-                int pixel_index = (j * width + i) * 4; 
-                
-                Color3 col = buffer[j * width + i] * scale;
-                
-                col.x = sqrt(col.x);
-                col.y = sqrt(col.y);
-                col.z = sqrt(col.z);
-                
-                pixels[pixel_index + 0] = (unsigned char)(256 * fmax(0.0, fmin(0.999, col.x)));
-                pixels[pixel_index + 1] = (unsigned char)(256 * fmax(0.0, fmin(0.999, col.y)));
-                pixels[pixel_index + 2] = (unsigned char)(256 * fmax(0.0, fmin(0.999, col.z)));
-                pixels[pixel_index + 3] = 255;
-            }
-        }
-    }
-    
+int main(int argc, char** argv) {
+    RenderOptions options;
+    if (!parse_render_options(argc, argv, options))
+        return 1;
 
-int main() {
-    SetConfigFlags(FLAG_WINDOW_HIGHDPI);
-    srand(static_cast<unsigned int>(time(NULL)));
+    if (!options.scene.empty() && options.scene != "spheres") {
+        std::cerr << "ERROR: Unknown scene '" << options.scene << "' (available: spheres).\n";
+        return 1;
+    }
 
-    const int screen_width = 400;
-    const int screen_height = 225;
+    const int screen_width = options.width > 0 ? options.width : 400;
+    const int screen_height = options.height > 0 ? options.height : 225;
     const double aspect_ratio = (double)screen_width / screen_height;
 
-    InitWindow(screen_width, screen_height, "Ray Tracer (Raylib) - Book 1");
-    SetTargetFPS(60);
-
     int samples_per_pixel = 1;
-    int max_depth = 10;
+    int max_depth = options.max_depth > 0 ? options.max_depth : 10;
     bool is_rendering = true;
     int accumulated_samples = 0;
 
@@ -130,12 +137,29 @@ int main() {
 
     RTCamera camera(lookfrom, lookat, vup, 40.0, aspect_ratio, aperture, dist_to_focus);
 
-    std::vector<Color3> accumulation_buffer(screen_width * screen_height, Color3(0, 0, 0));
+    HittableList world = create_scene();
+
+    if (options.headless) {
+        int spp = options.samples_per_pixel > 0 ? options.samples_per_pixel : 100;
+        std::vector<Color3> buffer = render_headless(screen_width, screen_height, spp, [&](int i, int j) {
+            double u = (i + random_double()) / (screen_width - 1);
+            double v = (j + random_double()) / (screen_height - 1);
+            return ray_color(camera.get_ray(u, 1.0 - v), world, max_depth);
+        });
+        return write_image(options.output, buffer, screen_width, screen_height, spp) ? 0 : 1;
+    }
+
+    SetConfigFlags(FLAG_WINDOW_HIGHDPI);
+
+    InitWindow(screen_width, screen_height, "Ray Tracer (Raylib) - Book 1");
+    SetTargetFPS(60);
+
+    AdaptiveSampler sampler(screen_width, screen_height);
+    bool show_density = false;
+    TileScheduler scheduler(screen_width, screen_height);
     Image render_image = GenImageColor(screen_width, screen_height, BLACK);
     Texture2D render_texture = LoadTextureFromImage(render_image);
 
-    HittableList world = create_scene();
-
     float move_speed = 0.05f;
     float mouse_sensitivity = 0.003f;
     bool camera_moved = false;
@@ -164,6 +188,9 @@ int main() {
 
         if (IsKeyPressed(KEY_P)) is_rendering = !is_rendering;
         if (IsKeyPressed(KEY_R)) camera_moved = true;
+        if (IsKeyPressed(KEY_T)) scheduler.write_timings(std::cout);
+        if (IsKeyPressed(KEY_M)) sampler.enabled = !sampler.enabled;
+        if (IsKeyPressed(KEY_V)) show_density = !show_density;
         
         if (IsKeyPressed(KEY_EQUAL) || IsKeyPressed(KEY_KP_ADD)) 
             samples_per_pixel = (samples_per_pixel + 1 < 10) ? samples_per_pixel + 1 : 10;
@@ -173,39 +200,49 @@ int main() {
         if (camera_moved) {
             accumulated_samples = 0;
             
-            std::fill(accumulation_buffer.begin(), accumulation_buffer.end(), Color3(0,0,0));
-
-            for (int j = 0; j < screen_height; j++) {
-                for (int i = 0; i < screen_width; i++) {
-                    double u = (i + 0.5) / (screen_width - 1);
-                    double v = (j + 0.5) / (screen_height - 1);
-                    RTRay r = camera.get_ray(u, 1.0 - v);
+            sampler.reset();
+
+            scheduler.run([&](const Tile& tile) {
+                for (int j = tile.y0; j < tile.y1; j++) {
+                    for (int i = tile.x0; i < tile.x1; i++) {
+                        seed_thread_rng(0, j * screen_width + i);
+                        double u = (i + 0.5) / (screen_width - 1);
+                        double v = (j + 0.5) / (screen_height - 1);
+                        RTRay r = camera.get_ray(u, 1.0 - v);
                     
-                    Color3 pixel_color = ray_color(r, world, max_depth);
-                    accumulation_buffer[j * screen_width + i] = pixel_color;
+                        Color3 pixel_color = ray_color(r, world, max_depth);
+                        sampler.add(j * screen_width + i, pixel_color);
+                    }
                 }
-            }
+            });
             accumulated_samples = 1;
 
-            buffer_to_image(render_image, accumulation_buffer, screen_width, screen_height, 1);
+            sampler.to_image(render_image, show_density);
             UpdateTexture(render_texture, render_image.data);
         }
         else if (is_rendering && accumulated_samples < 100) {
-            for (int j = 0; j < screen_height; j++) {
-                for (int i = 0; i < screen_width; i++) {
-                    Color3 pixel_color(0, 0, 0);
-                    for (int s = 0; s < samples_per_pixel; s++) {
-                        double u = (i + ((double)rand() / RAND_MAX)) / (screen_width - 1);
-                        double v = (j + ((double)rand() / RAND_MAX)) / (screen_height - 1);
-                        RTRay r = camera.get_ray(u, 1.0 - v);
-                        pixel_color += ray_color(r, world, max_depth);
+            scheduler.run([&](const Tile& tile) {
+                for (int j = tile.y0; j < tile.y1; j++) {
+                    for (int i = tile.x0; i < tile.x1; i++) {
+                        int pixel_index = j * screen_width + i;
+                        seed_thread_rng(accumulated_samples, pixel_index);
+                        int samples = sampler.samples_for(pixel_index, samples_per_pixel);
+                        for (int s = 0; s < samples; s++) {
+                            double u = (i + random_double()) / (screen_width - 1);
+                            double v = (j + random_double()) / (screen_height - 1);
+                            RTRay r = camera.get_ray(u, 1.0 - v);
+                            sampler.add(pixel_index, ray_color(r, world, max_depth));
+                        }
                     }
-                    accumulation_buffer[j * screen_width + i] += pixel_color;
                 }
-            }
+            });
             accumulated_samples += samples_per_pixel;
 
-            buffer_to_image(render_image, accumulation_buffer, screen_width, screen_height, accumulated_samples);
+            sampler.to_image(render_image, show_density);
+            UpdateTexture(render_texture, render_image.data);
+        }
+        else if (IsKeyPressed(KEY_V)) {
+            sampler.to_image(render_image, show_density);
             UpdateTexture(render_texture, render_image.data);
         }
 
@@ -218,6 +255,13 @@ int main() {
         DrawText(TextFormat("Samples: %d", accumulated_samples), 10, 35, 20, GREEN);
         DrawText(TextFormat("SPP: %d [+/-]", samples_per_pixel), 10, 60, 20, GREEN);
         DrawText(is_rendering ? "Rendering [P]" : "Paused [P]", 10, 85, 20, is_rendering ? GREEN : RED);
+        DrawText(TextFormat("Threads: %d", render_threads()), 10, 110, 20, GREEN);
+        const TileStats& tiles = scheduler.last_stats();
+        DrawText(TextFormat("Tiles: %d  max %.1f ms  steals %d [T]", tiles.tiles, tiles.max_ms, tiles.steals), 10, 135, 20, GREEN);
+        AdaptiveSampler::Summary spp = sampler.summary(samples_per_pixel);
+        DrawText(TextFormat("Adaptive [M]: %s  active %.0f%%  %.1f spp avg  %d max", sampler.enabled ? "on" : "off",
+                            100 * spp.active, spp.mean_samples, spp.max_samples), 10, 160, 20, GREEN);
+        DrawText(TextFormat("Density view [V]: %s", show_density ? "on" : "off"), 10, 185, 20, GREEN);
         DrawText("WASD: Move | Space/Shift: Up/Down | Mouse: Look | R: Reset", 10, screen_height - 30, 20, YELLOW);
         
         EndDrawing();